@@ -0,0 +1,86 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "bench-impl.h"
+
+// Replacing the global allocation functions lets the runner report the
+// allocations made per call by the bindings and by the code they call. Only
+// calls from within the add-on are counted, so on ELF platforms it is linked
+// with `-Bsymbolic`, which binds its calls to these definitions.
+static std::atomic<size_t> allocation_count(0);
+
+void* operator new(size_t size) {
+  allocation_count++;
+  void* result = malloc(size == 0 ? 1 : size);
+  if (result == nullptr) throw std::bad_alloc();
+  return result;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  allocation_count++;
+  return malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+  return operator new(size, tag);
+}
+
+void operator delete(void* data) noexcept { free(data); }
+void operator delete[](void* data) noexcept { free(data); }
+void operator delete(void* data, const std::nothrow_t&) noexcept {
+  free(data);
+}
+void operator delete[](void* data, const std::nothrow_t&) noexcept {
+  free(data);
+}
+
+bool Bench::baseline() { return true; }
+
+double Bench::addDoubles(double a, double b) { return a + b; }
+
+unsigned long Bench::addUnsigned(unsigned long a, unsigned long b) {
+  return a + b;
+}
+
+bool Bench::negate(bool value) { return !value; }
+
+DOMString Bench::echoString(DOMString value) { return value; }
+
+BenchMode Bench::echoMode(BenchMode value) { return value; }
+
+BenchPoint Bench::echoPoint(BenchPoint value) { return value; }
+
+double Bench::sumSequence(sequence<double>&& values) {
+  double sum = 0;
+  for (double item: values) sum += item;
+  return sum;
+}
+
+sequence<double> Bench::makeSequence(unsigned long length) {
+  sequence<double> result;
+  result.resize(length, 1.0);
+  return result;
+}
+
+double Bench::overloaded(double value) { return value; }
+
+double Bench::overloaded(DOMString value) {
+  return static_cast<double>(value.size());
+}
+
+double Bench::overloaded(double a, double b) { return a * b; }
+
+Promise<BenchPoint> Bench::resolvePoint(BenchPoint value) {
+  Promise<BenchPoint> promise;
+  promise.Resolve(value);
+  return promise;
+}
+
+// static
+double Bench::allocations() {
+  return static_cast<double>(allocation_count.load());
+}
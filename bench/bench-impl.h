@@ -0,0 +1,49 @@
+#ifndef WEBIDL_NAPI_BENCH_BENCH_IMPL_H
+#define WEBIDL_NAPI_BENCH_BENCH_IMPL_H
+
+#include "webidl-napi.h"
+
+using namespace WebIdlNapi;
+
+typedef bool boolean;
+
+enum BenchMode {
+  Fast,
+  Balanced,
+  Thorough
+};
+
+struct BenchPoint {
+  double x;
+  double y;
+  DOMString label;
+};
+
+class Bench {
+ public:
+  bool baseline();
+  double addDoubles(double a, double b);
+  unsigned long addUnsigned(unsigned long a, unsigned long b);
+  bool negate(bool value);
+
+  DOMString echoString(DOMString value);
+  BenchMode echoMode(BenchMode value);
+
+  BenchPoint echoPoint(BenchPoint value);
+  double sumSequence(sequence<double>&& values);
+  sequence<double> makeSequence(unsigned long length);
+
+  double overloaded(double value);
+  double overloaded(DOMString value);
+  double overloaded(double a, double b);
+
+  BenchPoint origin{0, 0, "origin"};
+  double value = 0;
+
+  Promise<BenchPoint> resolvePoint(BenchPoint value);
+
+  // Counts the calls to `operator new` made anywhere in the add-on.
+  static double allocations();
+};
+
+#endif  // WEBIDL_NAPI_BENCH_BENCH_IMPL_H
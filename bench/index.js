@@ -0,0 +1,132 @@
+'use strict';
+// Measures the cost of calling into the bindings generated for `bench.idl`.
+// For each case it reports the time and the number of native allocations per
+// call. Allocations are counted by the add-on's own `operator new`, so they
+// include those made by the generated code and by `webidl-napi-inl.h`, but not
+// those made inside the C++ runtime library, such as by `std::string` on some
+// platforms. Pass `--json <file>` to also write the results to a file which
+// can be compared against those of another release with `--compare <file>`.
+const fs = require('fs');
+const yargs = require('yargs');
+const argv = yargs
+  .usage('Usage: $0 [options]')
+  .describe('iterations', 'number of calls measured per case')
+  .default('iterations', 200000)
+  .describe('filter', 'only run the cases whose name contains this string')
+  .describe('json', 'write the results to this file as JSON')
+  .nargs('json', 1)
+  .describe('compare', 'compare the results with those in this JSON file')
+  .nargs('compare', 1)
+  .argv;
+
+const binding =
+  require('bindings')({ bindings: 'bench', module_root: __dirname });
+
+const bench = new binding.Bench();
+const point = { x: 1, y: 2, label: 'point' };
+const shortString = 'abc';
+const longString = 'x'.repeat(1024);
+const numbers = Array.from({ length: 16 }, (item, idx) => idx);
+
+const cases = {
+  'primitive/baseline': () => bench.baseline(),
+  'primitive/double': () => bench.addDoubles(1.5, 2.5),
+  'primitive/unsigned long': () => bench.addUnsigned(1, 2),
+  'primitive/boolean': () => bench.negate(true),
+  'string/short': () => bench.echoString(shortString),
+  'string/long': () => bench.echoString(longString),
+  'enum': () => bench.echoMode('balanced'),
+  'dictionary': () => bench.echoPoint(point),
+  'sequence/in': () => bench.sumSequence(numbers),
+  'sequence/out': () => bench.makeSequence(16),
+  'overload/double': () => bench.overloaded(3),
+  'overload/DOMString': () => bench.overloaded(shortString),
+  'overload/two arguments': () => bench.overloaded(3, 4),
+  'attribute/SameObject': () => bench.origin,
+  'attribute/get': () => bench.value,
+  'attribute/set': () => { bench.value = 5; },
+  'error/enum': () => {
+    try {
+      bench.echoMode('unknown');
+    } catch (error) {}
+  },
+  'error/type': () => {
+    try {
+      bench.addDoubles('1', 2);
+    } catch (error) {}
+  },
+};
+
+// These cases return promises, and each call is timed until it settles.
+const asyncCases = {
+  'promise': () => bench.resolvePoint(point),
+};
+
+function run(fn, count) {
+  for (let idx = 0; idx < count; idx++) fn();
+}
+
+async function runAsync(fn, count) {
+  for (let idx = 0; idx < count; idx++) await fn();
+}
+
+async function measure(fn, isAsync, iterations) {
+  const loop = isAsync ? runAsync : run;
+  await loop(fn, Math.min(iterations, 10000));
+  if (global.gc) global.gc();
+  const allocationsBefore = binding.Bench.allocations();
+  const start = process.hrtime.bigint();
+  await loop(fn, iterations);
+  const elapsed = process.hrtime.bigint() - start;
+  const allocations = binding.Bench.allocations() - allocationsBefore;
+  return {
+    nsPerCall: Number(elapsed) / iterations,
+    allocationsPerCall: allocations / iterations
+  };
+}
+
+function format(number, digits) {
+  return number.toFixed(digits).padStart(10);
+}
+
+async function main() {
+  const iterations = Number(argv.iterations);
+  const baseline = argv.compare
+    ? JSON.parse(fs.readFileSync(argv.compare, 'utf8')).results
+    : {};
+  const results = {};
+  console.log('case'.padEnd(28) + 'ns/call'.padStart(10) +
+    'allocs/call'.padStart(12) + (argv.compare ? 'change'.padStart(10) : ''));
+  const all = [
+    ...Object.entries(cases).map(([ name, fn ]) => [ name, fn, false ]),
+    ...Object.entries(asyncCases).map(([ name, fn ]) => [ name, fn, true ])
+  ];
+  for (const [ name, fn, isAsync ] of all) {
+    if (argv.filter && !name.includes(argv.filter)) continue;
+    const result = await measure(fn, isAsync, iterations);
+    results[name] = result;
+    const old = baseline[name];
+    console.log(name.padEnd(28) + format(result.nsPerCall, 1) +
+      format(result.allocationsPerCall, 2).padStart(12) +
+      (argv.compare
+        ? (old
+          ? (format((result.nsPerCall / old.nsPerCall - 1) * 100, 1) + '%')
+          : 'new'.padStart(10))
+        : ''));
+  }
+
+  if (argv.json) {
+    fs.writeFileSync(argv.json, JSON.stringify({
+      node: process.version,
+      napi: process.versions.napi,
+      platform: `${process.platform}-${process.arch}`,
+      iterations,
+      results
+    }, null, 2) + '\n');
+  }
+}
+
+main().catch((error) => {
+  console.error(error);
+  process.exitCode = 1;
+});
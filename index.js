@@ -11,6 +11,34 @@ const argv = yargs
   .nargs('i', 1)
   .nargs('o', 1)
   .describe('o', 'output file')
+  .boolean('split')
+  .describe('split',
+    'write each enum, dictionary, and interface to its own file next to the ' +
+    'output file, along with a header declaring what they share')
+  .boolean('list-outputs')
+  .describe('list-outputs',
+    'print the files that would be written, separated by semicolons, and exit')
+  .boolean('fast-shape')
+  .describe('fast-shape',
+    'construct dictionaries from a cached JS function, as though each were ' +
+    'marked [WebIdlNapiFastShape]')
+  .boolean('instrument')
+  .describe('instrument',
+    'count the calls to each binding and converter, and export the counts ' +
+    'via __webidlNapiStats()')
+  .boolean('instrument-timing')
+  .describe('instrument-timing',
+    'like --instrument, but also measure the time taken by each call')
+  .choices('same-object', [ 'reference', 'property' ])
+  .default('same-object', 'reference')
+  .describe('same-object',
+    'how to cache the values of [SameObject] attributes: "property" stores ' +
+    'them on the JS object under a symbol rather than referencing them from ' +
+    'the native instance')
+  .boolean('lazy-interfaces')
+  .describe('lazy-interfaces',
+    'define each interface only when it is first accessed on the exports or ' +
+    'first returned to JS')
   .argv;
 
 if (argv._.length === 0) {
@@ -24,6 +52,7 @@ if (argv.I) {
 }
 
 const { parse } = require('webidl2');
+const crypto = require('crypto');
 const fs = require('fs');
 const path = require('path');
 
@@ -52,11 +81,187 @@ const typemapWebIDLBasicTypesToNAPI = {
   'USVString': { type: 'napi_string', converter: 'USVString' },
 
   // object
-  'object': { type: 'napi_object', converter: 'object' }
+  'object': { type: 'napi_object', converter: 'object' },
+
+  // buffer
+  'ArrayBuffer': { type: 'napi_object', converter: 'ArrayBuffer' },
+  'ArrayBufferView': { type: 'napi_object', converter: 'ArrayBufferView' },
+  'BufferSource': { type: 'napi_object', converter: 'BufferSource' },
+  'Int8Array': { type: 'napi_object', converter: 'Int8Array' },
+  'Uint8Array': { type: 'napi_object', converter: 'Uint8Array' },
+  'Uint8ClampedArray': { type: 'napi_object', converter: 'Uint8ClampedArray' },
+  'Int16Array': { type: 'napi_object', converter: 'Int16Array' },
+  'Uint16Array': { type: 'napi_object', converter: 'Uint16Array' },
+  'Int32Array': { type: 'napi_object', converter: 'Int32Array' },
+  'Uint32Array': { type: 'napi_object', converter: 'Uint32Array' },
+  'Float32Array': { type: 'napi_object', converter: 'Float32Array' },
+  'Float64Array': { type: 'napi_object', converter: 'Float64Array' },
+  'BigInt64Array': { type: 'napi_object', converter: 'BigInt64Array' },
+  'BigUint64Array': { type: 'napi_object', converter: 'BigUint64Array' }
+};
+
+// The typed arrays in which sequences of WebIDL numeric types are returned to
+// JS when marked [WebIdlNapiTypedArray].
+const typedArraysForNumericTypes = {
+  'byte': 'Int8Array',
+  'octet': 'Uint8Array',
+  'short': 'Int16Array',
+  'unsigned short': 'Uint16Array',
+  'long': 'Int32Array',
+  'unsigned long': 'Uint32Array',
+  'long long': 'BigInt64Array',
+  'unsigned long long': 'BigUint64Array',
+  'float': 'Float32Array',
+  'unrestricted float': 'Float32Array',
+  'double': 'Float64Array',
+  'unrestricted double': 'Float64Array'
 };
 
+// With `--split`, the definitions used by more than one of the generated files
+// have external linkage, and are declared in the shared header.
+const split = !!argv.split;
+const sharedLinkage = (split ? '' : 'static ');
+
+// With `--same-object property`, the value of each [SameObject] attribute is
+// cached in a read-only, non-enumerable property of the JS object, keyed by a
+// symbol unique to the attribute and the env, rather than in a reference held
+// by the wrapping. The value then lives exactly as long as the object does.
+// Objects which no property can be added to, such as frozen ones, fall back to
+// the reference, for which the wrapping keeps room.
+const sameObjectProperty = (argv['same-object'] === 'property');
+
+// Generate the retrieval of the cached value of the [SameObject] attribute at
+// `idx` into `target`, which is left `undefined` if there is none. The key is
+// retrieved into `key` for storing the value afterwards.
+function generateSameObjectLookup(ifname, idx, key, target) {
+  return [
+    `NAPI_CALL(env,`,
+    `    webidl_napi_interface_${ifname}_same_obj_keys.Get(`,
+    `        env,`,
+    `        ${idx},`,
+    `        &${key}));`,
+    `NAPI_CALL(env,`,
+    `    napi_get_property(env, js_rcv, ${key}, &${target}));`,
+  ];
+}
+
+// Generate the caching of `value` under `key`, or in the reference at `idx`
+// of `wrapping` if the property cannot be defined.
+function generateSameObjectStore(idx, key, value) {
+  return [
+    `napi_property_descriptor same_obj_prop = {};`,
+    `same_obj_prop.name = ${key};`,
+    `same_obj_prop.value = ${value};`,
+    `if (napi_define_properties(env, js_rcv, 1, &same_obj_prop) != napi_ok) {`,
+    `  bool is_pending;`,
+    `  NAPI_CALL(env, napi_is_exception_pending(env, &is_pending));`,
+    `  if (is_pending) return nullptr;`,
+    `  NAPI_CALL(env, wrapping->SetRef(env, ${idx}, ${value}));`,
+    `}`,
+  ];
+}
+
+// With `--instrument`, each binding and converter records its calls in
+// statistics kept per env. The names of the bindings are collected as their
+// code is generated, and the index of each name identifies its statistics.
+// The statistics are found via `source`, which is 'info' for bindings, whose
+// callback data is the `InstanceData`, 'idata' for code which has it at hand,
+// and which is otherwise retrieved from the env.
+const instrumentTiming = !!argv['instrument-timing'];
+const instrument = (!!argv.instrument || instrumentTiming);
+const instrumentedNames = [];
+function generateInstrumentation(name, source) {
+  if (!instrument) return [];
+  instrumentedNames.push(name);
+  return [
+    `  WebIdlNapi::BindingScope<${instrumentTiming}> webidl_napi_scope(`,
+    ...(source === 'idata' ? [ `      idata,` ] : [
+      `      env,`,
+      ...(source === 'info' ? [ `      info,` ] : []),
+    ]),
+    `      webidl_napi_stats_slot,`,
+    `      ${instrumentedNames.length - 1});`,
+  ];
+}
+
+function hasExtAttr(item, attrName) {
+  return (item.extAttrs || []).some(({ name }) => (name === attrName));
+}
+
+// Derive the type tag of an interface from its definition and from the names
+// of the module and of the interface, so that builds are reproducible, and so
+// that the tag does not change when other definitions do.
+function generateTypeTag(iface, declareOnly) {
+  if (declareOnly) {
+    return [
+      `template <>`,
+      `const WebIdlNapi::TypeTag`,
+      `WebIdlNapi::InterfaceTraits<${iface.name}>::type_tag;`,
+      ``,
+    ];
+  }
+  const digest = crypto.createHash('sha256')
+    .update(`${parsedPath.name}\0${iface.name}\0`)
+    .update(JSON.stringify(iface))
+    .digest();
+  return [
+    `template <>`,
+    `const WebIdlNapi::TypeTag`,
+    `WebIdlNapi::InterfaceTraits<${iface.name}>::type_tag = {`,
+    `  0x${digest.toString('hex', 0, 8)}ULL,`,
+    `  0x${digest.toString('hex', 8, 16)}ULL`,
+    `};`,
+    ``,
+  ];
+}
+
+// With `--split`, the forward declarations go into the shared header, which
+// declares the type tags of the interfaces, leaving their definition to the
+// files of the interfaces. Dictionaries and interfaces which hold no JS values
+// are declared as such, so that sequences of them are converted in chunks of
+// handle scopes, and each dictionary declares its element converter.
 function generateForwardDeclaration(decl) {
+  const holdsNoJSValues = (decl.type === 'interface' ||
+    (decl.type === 'dictionary' && !holdsJSValue({ idlType: decl.name })));
   return [
+    ...((decl.type !== 'enum') ? [
+      `namespace WebIdlNapi {`,
+      ...(holdsNoJSValues ? [
+        `template <>`,
+        `struct ContainsJSValue<${decl.name}> : public std::false_type {};`,
+      ] : []),
+      ...(decl.type === 'dictionary' ? [
+        ...(holdsNoJSValues ? [ `` ] : []),
+        `template <>`,
+        `class ElementConverter<${decl.name}> {`,
+        ` public:`,
+        `  napi_status Init(napi_env env);`,
+        `  napi_status ToNative(napi_env env,`,
+        `                       napi_value val,`,
+        `                       ${decl.name}* result);`,
+        `  napi_status ToJS(napi_env env,`,
+        `                   const ${decl.name}& val,`,
+        `                   napi_value* result);`,
+        ...(decl.members.length > 0 ? [
+          ` private:`,
+          `  napi_value keys[${decl.members.length}];`,
+        ] : []),
+        `};`,
+      ] : []),
+      `}  // end of namespace WebIdlNapi`,
+      ``,
+    ] : []),
+    ...(decl.type === 'interface' ? [
+      ...generateTypeTag(decl, split),
+      `template <>`,
+      `napi_status`,
+      `WebIdlNapi::InterfaceTraits<${decl.name}>::ToJS(`,
+      `    napi_env env,`,
+      `    WebIdlNapi::InstanceData* idata,`,
+      `    const ${decl.name}& val,`,
+      `    napi_value* result);`,
+      ``,
+    ] : []),
     `template <>`,
     `napi_status`,
     `WebIdlNapi::Converter<${decl.name}>::ToNative(`,
@@ -109,22 +314,101 @@ function generateBasicTypeMaps(typedef) {
   ].join('\n');
 }
 
-// Render generics as templated types.
+// Render generics as templated types, and nullable types as
+// `WebIdlNapi::Nullable<T>`.
 function generateNativeType(idlType) {
-  return ((typeof idlType.idlType === 'string')
+  const nativeType = ((typeof idlType.idlType === 'string')
     ? idlType.idlType
-    : `WebIdlNapi::${idlType.generic}<${idlType.idlType[0].idlType}>`);
+    : `WebIdlNapi::${idlType.generic}<` +
+        `${generateNativeType(idlType.idlType[0])}>`);
+  return (idlType.nullable
+    ? `WebIdlNapi::Nullable<${nativeType}>`
+    : nativeType);
+}
+
+// The native type of `idlType` with its nullability removed.
+function generateBaseType(idlType) {
+  return generateNativeType({ ...idlType, nullable: false });
+}
+
+// Optional arguments without a default value are passed as
+// `WebIdlNapi::Optional<T>`, unless they are nullable already.
+function generateArgType(arg) {
+  const nativeType = generateNativeType(arg.idlType);
+  return ((arg.optional && !arg.default && !arg.idlType.nullable)
+    ? `WebIdlNapi::Optional<${nativeType}>`
+    : nativeType);
 }
 
 function generateConverter(idlType) {
+  // Objects implementing a callback interface are converted by a converter
+  // generated for the interface, which knows the name of its operation.
+  if (typeof idlType.idlType === 'string' && !idlType.nullable &&
+      callbackIfaces[idlType.idlType]) {
+    return `webidl_napi_callback_interface_${idlType.idlType}`;
+  }
   // If it's a templated type, like `Promise<Something>`, use `::` for the
   // converter, otherwise use `WebIdlNapi::Converter<type>::`.
-  const ret = ((typeof idlType.idlType === 'object' && !!idlType.generic)
+  const ret = ((typeof idlType.idlType === 'object' && !!idlType.generic &&
+      !idlType.nullable)
     ? `${generateNativeType(idlType)}`
     : `WebIdlNapi::Converter<${generateNativeType(idlType)}>`);
   return ret;
 }
 
+// Whether values of the type are native instances of an interface, which are
+// converted to JS via `InterfaceTraits<T>::ToJS()`, and so need the
+// `InstanceData` of the env.
+function isInterfaceType(idlType) {
+  return (typeof idlType.idlType === 'string' && !idlType.nullable &&
+    !!ifaces[idlType.idlType]);
+}
+
+// Whether native values of the type hold JS values, such as `object`, which are
+// valid only on the JS thread and only while the handle scope they were created
+// in remains open.
+function holdsJSValue(idlType, seen = new Set()) {
+  if (typeof idlType.idlType !== 'string') {
+    return idlType.idlType.some((item) => holdsJSValue(item, seen));
+  }
+  const name = idlType.idlType;
+  if (name === 'object' || name === 'any') {
+    return true;
+  }
+  if (seen.has(name)) {
+    return false;
+  }
+  seen.add(name);
+  const typedef = tree.find((item) =>
+    (item.type === 'typedef' && item.name === name));
+  if (typedef) {
+    return holdsJSValue(typedef.idlType, seen);
+  }
+  return (!!dicts[name] &&
+    dicts[name].members.some((member) => holdsJSValue(member.idlType, seen)));
+}
+
+// Generate the function which converts the value of an attribute or the return
+// value of an operation to JS. Instances of interfaces are converted by passing
+// the `idata` of the binding as well. Sequences of numbers marked
+// [WebIdlNapiTypedArray] are converted to a typed array rather than an array.
+function generateToJS(item) {
+  const idlType = item.idlType;
+  if (isInterfaceType(idlType)) {
+    return `WebIdlNapi::InterfaceTraits<${idlType.idlType}>::ToJS`;
+  }
+  if (!hasExtAttr(item, 'WebIdlNapiTypedArray')) {
+    return `${generateConverter(idlType)}::ToJS`;
+  }
+  const arrayType = (['sequence', 'FrozenArray'].includes(idlType.generic) &&
+    typedArraysForNumericTypes[idlType.idlType[0].idlType]);
+  if (!arrayType) {
+    throw new Error(`[WebIdlNapiTypedArray] on ${item.name} requires a ` +
+      `sequence or FrozenArray of a numeric type`);
+  }
+  return `${generateConverter(idlType)}::ToTypedArray<${arrayType}>`;
+}
+
 function generateInitializerList(list, indent) {
   indent = indent || '';
   return (Array.isArray(list)
@@ -136,19 +420,105 @@ function generateInitializerList(list, indent) {
     : indent + list);
 }
 
+function generateByteLiteral(byte) {
+  const char = String.fromCharCode(byte);
+  return ((byte >= 0x20 && byte < 0x7f && char !== '\'' && char !== '\\')
+    ? `'${char}'`
+    : `0x${byte.toString(16)}`);
+}
+
+// Match the string against the enum values without allocating. The string is
+// copied into a stack buffer one byte longer than the longest value, so a
+// longer string fills the buffer and matches no value. We then switch on the
+// length and on the first byte, so that at most a few values are compared.
+function generateEnumToNativeBody(enumDef, valueMap) {
+  const byLength = enumDef.values.reduce((soFar, { value }) => {
+    const length = Buffer.byteLength(value);
+    soFar[length] = [ ...(soFar[length] || []), value ];
+    return soFar;
+  }, {});
+  const maxLength = Math.max(0, ...Object.keys(byLength).map(Number));
+  function generateMatch(value, indent) {
+    return [
+      `if (!memcmp(str_val, "${value}", ${Buffer.byteLength(value)})) {`,
+      `  *result = ${enumDef.name}::${valueMap[value]};`,
+      `  return napi_ok;`,
+      `}`
+    ].map((line) => indent + line);
+  }
+  // N-API truncates on character boundaries, so the buffer has room for one
+  // more character of up to four bytes and the terminating null. Any string
+  // longer than the longest value thus yields a longer length, matching none.
+  return [
+    `  char str_val[${maxLength + 5}];`,
+    `  size_t length;`,
+    `  napi_status status = napi_get_value_string_utf8(`,
+    `      env,`,
+    `      val,`,
+    `      str_val,`,
+    `      sizeof(str_val),`,
+    `      &length);`,
+    `  if (status != napi_ok) return status;`,
+    ``,
+    `  switch (length) {`,
+    ...Object.entries(byLength).reduce((soFar, [ length, values ]) => {
+      const byFirst = values.reduce((byFirst, value) => {
+        const first = Buffer.from(value)[0];
+        byFirst[first] = [ ...(byFirst[first] || []), value ];
+        return byFirst;
+      }, {});
+      return soFar.concat(Number(length) === 0 ? [
+        `    case 0:`,
+        `      *result = ${enumDef.name}::${valueMap['']};`,
+        `      return napi_ok;`
+      ] : [
+        `    case ${length}:`,
+        `      switch (static_cast<unsigned char>(str_val[0])) {`,
+        ...Object.entries(byFirst).reduce((cases, [ first, group ]) =>
+          cases.concat([
+            `        case ${generateByteLiteral(Number(first))}:`,
+            ...group.reduce((matches, value) =>
+              matches.concat(generateMatch(value, '          ')), []),
+            `          break;`
+          ]), []),
+        `      }`,
+        `      break;`
+      ]);
+    }, []),
+    `  }`,
+    ``,
+    `  return napi_invalid_arg;`
+  ];
+}
+
+// For the native enum value, if the string is empty, generate `_empty`.
+// Otherwise, the generated value is obtained by uppercasing the first letter and
+// replacing anything that's not an ASCII letter or a number with an underscore.
+function generateEnumValueName(value) {
+  return (value === ''
+    ? '_empty'
+    : value[0].toUpperCase() + value.slice(1).replace(/[^0-9a-zA-Z]/g, '_'));
+}
+
 function generateEnumMaps(enumDef) {
   const valueMap = enumDef.values.reduce((soFar, item) => Object.assign(soFar, {
-    // For the native enum value, if the string is empty, generate `_empty`.
-    // Otherwise, the generated value is obtained by uppercasing the first
-    // letter and replacing anything that's not an ASCII letter or a number
-    // with an underscore.
-    [item.value]: (item.value === ''
-      ? '_empty'
-      : item.value[0].toUpperCase() +
-        item.value.slice(1).replace(/[^0-9a-zA-Z]/g, '_'))
+    [item.value]: generateEnumValueName(item.value)
   }), {});
+  const values = `webidl_napi_enum_${enumDef.name}_values`;
 
   return [
+    // Declare the value names once, so that the JS strings returned to JS need
+    // only be created once per env.
+    ...(enumDef.values.length > 0 ? [
+      `static const char* const ${values}_names[] =`,
+      generateInitializerList(enumDef.values.map(({ value }) => `"${value}"`)) +
+        ';',
+      ``,
+      `static const WebIdlNapi::CachedStrings ${values}(`,
+      `    ${values}_names,`,
+      `    ${enumDef.values.length});`,
+      ``,
+    ] : []),
     //
     // The conversion to native
     //
@@ -158,24 +528,8 @@ function generateEnumMaps(enumDef) {
     `    napi_env env,`,
     `    napi_value val,`,
     `    ${enumDef.name}* result) {`,
-    `  DOMString str_val;`,
-    `  napi_status status = WebIdlNapi::Converter<DOMString>::ToNative(`,
-    `      env,`,
-    `      val,`,
-    `      &str_val);`,
-    `  if (status != napi_ok) return status;`,
-    ``,
-    // Generate an if-statement for each possible enum value, and one for the
-    // case where the value is not in the list. Join the statements with `else`.
-    [
-      ...enumDef.values.map((val) => [
-        `  if (!strncmp(str_val.c_str(), "${val.value}", str_val.size())) {`,
-        `    *result = ${enumDef.name}::${valueMap[val.value]};`,
-        `  }`,
-      ].join('\n')),
-      `    { status = napi_invalid_arg; }`
-    ].join('\n  else\n'),
-    `  return status;`,
+    ...generateInstrumentation(`${enumDef.name}_ToNative`),
+    ...generateEnumToNativeBody(enumDef, valueMap),
     `}`,
     ``,
     //
@@ -187,138 +541,512 @@ function generateEnumMaps(enumDef) {
     `    napi_env env,`,
     `    const ${enumDef.name}& val,`,
     `    napi_value* result) {`,
-    `  napi_status status = napi_ok;`,
-    ``,
-    // Generate an if-statement for each possible enum value, and one for the case
-    // where the value is not in the list. Join the statements with `else`.
-    [
-      ...enumDef.values.map((val) => [
-        `  if (val == ${enumDef.name}::${valueMap[val.value]}) {`,
-        `    status = napi_create_string_utf8(`,
-        `        env,`,
-        `        "${val.value}",`,
-        `        NAPI_AUTO_LENGTH,`,
-        `        result);`,
-        `  }`,
-      ].join('\n')),
-      `    { status = napi_invalid_arg; }`
-    ].join('\n  else\n'),
-    `  return status;`,
+    ...generateInstrumentation(`${enumDef.name}_ToJS`),
+    // Generate a case for each possible enum value, which returns the cached
+    // string at the index of the value.
+    ...(enumDef.values.length > 0 ? [
+      `  switch (val) {`,
+      ...enumDef.values.reduce((soFar, val, idx) => soFar.concat([
+        `    case ${enumDef.name}::${valueMap[val.value]}:`,
+        `      return ${values}.Get(env, ${idx}, result);`,
+      ]), []),
+      `  }`,
+      ``,
+    ] : []),
+    `  return napi_invalid_arg;`,
     `}`
   ].join('\n');
 }
 
+// Create the object by setting each member on a new empty object.
+function generateDictionaryPropsToJS(dict) {
+  const keyCount = dict.members.length;
+  return [
+    `  napi_status status;`,
+    `  napi_value ret;`,
+    ``,
+    `  status = napi_create_object(env, &ret);`,
+    `  if (status != napi_ok) return status;`,
+    ``,
+    // Convert each member from its native type to a `napi_value`, and define
+    // all of them on the object with a single call using the cached keys.
+    ...(keyCount > 0 ? [
+      `  napi_property_descriptor props[${keyCount}] = {};`,
+      ...dict.members.reduce((soFar, member, idx) => soFar.concat([
+        `  props[${idx}].name = keys[${idx}];`,
+        `  props[${idx}].attributes = static_cast<napi_property_attributes>(`,
+        `      napi_writable | napi_enumerable | napi_configurable);`,
+        `  status = ${generateConverter(member.idlType)}::ToJS(`,
+        `      env,`,
+        `      val.${member.name},`,
+        `      &props[${idx}].value);`,
+        `  if (status != napi_ok) return status;`,
+        ``
+      ]), []),
+      `  status = napi_define_properties(env, ret, ${keyCount}, props);`,
+      `  if (status != napi_ok) return status;`,
+      ``,
+    ] : []),
+    `  *result = ret;`,
+    `  return napi_ok;`,
+  ];
+}
+
+// Create the object by passing the converted members to a JS function which
+// returns them as an object literal, so that all objects created for this
+// dictionary share one shape.
+function generateDictionaryShapeToJS(dict) {
+  const keyCount = dict.members.length;
+  return [
+    `  napi_status status;`,
+    `  napi_value shape, undefined;`,
+    `  napi_value js_members[${keyCount}];`,
+    ``,
+    ...dict.members.reduce((soFar, member, idx) => soFar.concat([
+      `  status = ${generateConverter(member.idlType)}::ToJS(`,
+      `      env,`,
+      `      val.${member.name},`,
+      `      &js_members[${idx}]);`,
+      `  if (status != napi_ok) return status;`,
+      ``
+    ]), []),
+    `  status = webidl_napi_dictionary_${dict.name}_shape.Get(env, &shape);`,
+    `  if (status != napi_ok) return status;`,
+    ``,
+    `  status = napi_get_undefined(env, &undefined);`,
+    `  if (status != napi_ok) return status;`,
+    ``,
+    `  return napi_call_function(`,
+    `      env,`,
+    `      undefined,`,
+    `      shape,`,
+    `      ${keyCount},`,
+    `      js_members,`,
+    `      result);`,
+  ];
+}
+
+// Declare the JS function used by `generateDictionaryShapeToJS()`. It may look
+// like this: (function(a0, a1) { return { 'name': a0, 'count': a1 }; })
+function generateDictionaryShape(dict) {
+  const params = dict.members.map((member, idx) => `a${idx}`);
+  return [
+    `static const WebIdlNapi::CachedFunction`,
+    `webidl_napi_dictionary_${dict.name}_shape(`,
+    `    "(function(${params.join(', ')}) {"`,
+    `    "  return {"`,
+    ...dict.members.map((member, idx) =>
+      `    "    '${member.name}': ${params[idx]}` +
+        (idx < dict.members.length - 1 ? ',"' : '"')),
+    `    "  };"`,
+    `    "})");`,
+    ``,
+  ];
+}
+
+// Render a string as a C++ string literal in the given encoding, which is one of
+// 'utf8', 'utf16', or 'latin1', without depending on the encoding of the
+// generated source or on the execution character set of the compiler. All but
+// printable ASCII is therefore escaped, as octal escapes of the bytes for UTF-8
+// and Latin-1, and as universal character names for UTF-16. Lone surrogates
+// cannot be written as either, and are written as hex escapes of themselves in
+// UTF-16, and as U+FFFD in UTF-8, which is how N-API converts them to UTF-8.
+function generateStringLiteral(str, encoding) {
+  function octal(bytes) {
+    return [ ...bytes ].map((byte) =>
+      `\\${byte.toString(8).padStart(3, '0')}`).join('');
+  }
+  let literal = '';
+  let afterHexEscape = false;
+  for (const char of str) {
+    const code = char.codePointAt(0);
+    const isLoneSurrogate = (code >= 0xd800 && code <= 0xdfff);
+    if (afterHexEscape && /[0-9a-fA-F]/.test(char)) {
+      literal += '" u"';
+    }
+    afterHexEscape = false;
+    if (code >= 0x20 && code < 0x7f) {
+      literal += (/["\\?]/.test(char) ? `\\${char}` : char);
+    } else if (code < 0x80 || encoding === 'latin1') {
+      if (code > 0xff) {
+        throw new Error(`Character U+${code.toString(16)} of ${
+          JSON.stringify(str)} is not in Latin-1`);
+      }
+      literal += octal([ code ]);
+    } else if (encoding === 'utf8') {
+      literal += octal(Buffer.from(isLoneSurrogate ? '\ufffd' : char));
+    } else if (isLoneSurrogate) {
+      literal += `\\x${code.toString(16)}`;
+      afterHexEscape = true;
+    } else {
+      literal += (code > 0xffff
+        ? `\\U${code.toString(16).padStart(8, '0')}`
+        : `\\u${code.toString(16).padStart(4, '0')}`);
+    }
+  }
+  return `"${literal}"`;
+}
+
+// Render the default value of a dictionary member or of an optional argument as
+// a C++ expression. The default value of a dictionary type is `{}`, which has
+// no such expression, and which is instead obtained by converting `undefined`.
+function generateDefaultValue(item) {
+  const nativeType = generateNativeType(item.idlType);
+  const baseType = generateBaseType(item.idlType);
+  const value = item.default;
+  switch (value.type) {
+    case 'number':
+    case 'boolean':
+      return `${value.value}`;
+    case 'Infinity':
+      return `std::numeric_limits<double>::infinity()`;
+    case '-Infinity':
+      return `-std::numeric_limits<double>::infinity()`;
+    case 'NaN':
+      return `std::numeric_limits<double>::quiet_NaN()`;
+    case 'null':
+    case 'sequence':
+      return `${nativeType}()`;
+    case 'string':
+      if (enums.some((item) => (item.name === baseType))) {
+        return `${baseType}::${generateEnumValueName(value.value)}`;
+      }
+      if (baseType === 'ByteString') {
+        return `ByteString(${generateStringLiteral(value.value, 'latin1')})`;
+      }
+      if (baseType !== 'DOMString') {
+        return `${baseType}(${generateStringLiteral(value.value, 'utf8')})`;
+      }
+      // The UTF-8 and the UTF-16 forms of a string differ unless it is ASCII.
+      return (/^[\x20-\x7e]*$/.test(value.value)
+        ? `DOMString(WEBIDL_NAPI_DOMSTRING_LITERAL(` +
+          `${generateStringLiteral(value.value, 'utf8')}))`
+        : `DOMString(WEBIDL_NAPI_DOMSTRING_LITERAL_OF(` +
+          `${generateStringLiteral(value.value, 'utf8')}, ` +
+          `u${generateStringLiteral(value.value, 'utf16')}))`);
+    case 'dictionary':
+      return null;
+    default:
+      throw new Error(`Unsupported default value for ${item.name}`);
+  }
+}
+
+// Convert each member which is present, which is one whose value is not
+// `undefined`, and give each absent member its default value. The default
+// values given in the IDL are assigned directly. Members without one take the
+// value they have in a default-constructed native dictionary, and required
+// members cause the conversion to fail. `undefined` and `null` convert to a
+// dictionary with all members absent without retrieving any of them. Members
+// whose conversion rejects `undefined`, such as numbers and strings, are
+// converted right away, and their type is checked only if that fails, so that
+// present members cost no additional call.
+function generateDictionaryToNative(dict) {
+  const hasNativeDefaults = dict.members.some((member) =>
+    (!member.required && !member.default));
+  function rejectsUndefined(idlType) {
+    return (!idlType.nullable && [ 'napi_boolean', 'napi_number', 'napi_string' ]
+      .includes(generateNapiType(idlType)));
+  }
+  function generateMemberToNative(member, indent) {
+    return [
+      `status = ${generateConverter(member.idlType)}::ToNative(`,
+      `    env,`,
+      `    js_member,`,
+      `    &(result->${member.name}));`,
+    ].map((line) => indent + line);
+  }
+  function generateAbsent(member) {
+    if (member.required) {
+      return [ `      return napi_invalid_arg;` ];
+    }
+    if (!member.default) {
+      return [ `      result->${member.name} = defaults.${member.name};` ];
+    }
+    const value = generateDefaultValue(member);
+    return ((value === null) ? [
+      `      status = ${generateConverter(member.idlType)}::ToNative(`,
+      `          env,`,
+      `          js_member,`,
+      `          &(result->${member.name}));`,
+      `      if (status != napi_ok) return status;`,
+    ] : [
+      `      result->${member.name} = ${value};`,
+    ]);
+  }
+  return [
+    `  napi_status status;`,
+    `  napi_valuetype val_type;`,
+    `  status = napi_typeof(env, val, &val_type);`,
+    `  if (status != napi_ok) return status;`,
+    ``,
+    `  bool is_empty = (val_type == napi_undefined || val_type == napi_null);`,
+    `  if (!is_empty && val_type != napi_object && val_type != napi_function)`,
+    `    return napi_object_expected;`,
+    ``,
+    ...(hasNativeDefaults ? [
+      `  static const ${dict.name} defaults = ${dict.name}();`,
+      ``,
+    ] : []),
+    ...dict.members.reduce((soFar, member, idx) => soFar.concat(
+      rejectsUndefined(member.idlType) ? [
+        `  {`,
+        `    napi_value js_member = val;`,
+        `    bool is_absent = is_empty;`,
+        `    if (!is_empty) {`,
+        `      status = napi_get_property(env, val, keys[${idx}], &js_member);`,
+        `      if (status != napi_ok) return status;`,
+        ``,
+        ...generateMemberToNative(member, '      '),
+        `      if (status != napi_ok) {`,
+        `        napi_valuetype member_type;`,
+        `        napi_status type_status =`,
+        `            napi_typeof(env, js_member, &member_type);`,
+        `        if (type_status != napi_ok) return type_status;`,
+        `        if (member_type != napi_undefined) return status;`,
+        `        is_absent = true;`,
+        `      }`,
+        `    }`,
+        ``,
+        `    if (is_absent) {`,
+        ...generateAbsent(member),
+        `    }`,
+        `  }`,
+        ``,
+      ] : [
+        `  {`,
+        `    napi_value js_member = val;`,
+        `    napi_valuetype member_type = napi_undefined;`,
+        `    if (!is_empty) {`,
+        `      status = napi_get_property(env, val, keys[${idx}], &js_member);`,
+        `      if (status != napi_ok) return status;`,
+        ``,
+        `      status = napi_typeof(env, js_member, &member_type);`,
+        `      if (status != napi_ok) return status;`,
+        `    }`,
+        ``,
+        `    if (member_type != napi_undefined) {`,
+        ...generateMemberToNative(member, '      '),
+        `      if (status != napi_ok) return status;`,
+        `    } else {`,
+        ...generateAbsent(member),
+        `    }`,
+        `  }`,
+        ``,
+      ]), []),
+    `  return napi_ok;`,
+  ];
+}
+
+// The conversions of a dictionary are made by its `WebIdlNapi::ElementConverter`,
+// which retrieves the keys of its members once, so that a sequence of
+// dictionaries retrieves them only once for all its elements.
 function generateDictionaryMaps(dict) {
+  const keys = `webidl_napi_dictionary_${dict.name}_keys`;
+  const keyCount = dict.members.length;
+  const fastShape =
+    (keyCount > 0 &&
+      (argv['fast-shape'] || hasExtAttr(dict, 'WebIdlNapiFastShape')));
+  const converter = `WebIdlNapi::ElementConverter<${dict.name}>`;
   return [
-  `template <>`,
+  // Declare the member names once, so that the JS strings used as property
+  // keys need only be created once per env.
+  ...(keyCount > 0 ? [
+    `static const char* const ${keys}_names[] =`,
+    generateInitializerList(dict.members.map((member) => `"${member.name}"`)) +
+      ';',
+    ``,
+    `static const WebIdlNapi::CachedStrings ${keys}(`,
+    `    ${keys}_names,`,
+    `    ${keyCount});`,
+    ``,
+  ] : []),
+  ...(fastShape ? generateDictionaryShape(dict) : []),
   `napi_status`,
-  `WebIdlNapi::Converter<${dict.name}>::ToNative(`,
+  `${converter}::Init(napi_env env) {`,
+  (keyCount > 0 ? `  return ${keys}.Get(env, keys);` : `  return napi_ok;`),
+  `}`,
+  ``,
+  `napi_status`,
+  `${converter}::ToNative(`,
   `    napi_env env,`,
   `    napi_value val,`,
   `    ${dict.name}* result) {`,
-  `  napi_status status;`,
-  ...dict.members.reduce((soFar, member) => soFar.concat([
-    `  {`,
-    `    napi_value js_member;`,
-    `    status = napi_get_named_property(env,`,
-    `        val,`,
-    `        "${member.name}",`,
-    `        &js_member);`,
-    `    if (status != napi_ok) return status;`,
-    ``,
-    `    status = ${generateConverter(member.idlType)}::ToNative(`,
-    `        env,`,
-    `        js_member,`,
-    `        &(result->${member.name}));`,
-    `    if (status != napi_ok) return status;`,
-    `  }`,
-  ]), []),
-  `  return napi_ok;`,
+  ...generateInstrumentation(`${dict.name}_ToNative`),
+  ...generateDictionaryToNative(dict),
   `}`,
   ``,
-  `template <>`,
   `napi_status`,
-  `WebIdlNapi::Converter<${dict.name}>::ToJS(`,
+  `${converter}::ToJS(`,
   `    napi_env env,`,
   `    const ${dict.name}& val,`,
   `    napi_value* result) {`,
-  `  napi_status status;`,
-  `  napi_value ret;`,
-  // Declare a `napi_value` `js_prop_0`, `js_prop_1`, ... for each member.
-  `  napi_value`,
-  `    ${dict.members.map((item, idx) => `js_prop_${idx}`).join(',\n    ')};`,
+  ...generateInstrumentation(`${dict.name}_ToJS`),
+  ...(fastShape
+    ? generateDictionaryShapeToJS(dict)
+    : generateDictionaryPropsToJS(dict)),
+  `}`,
   ``,
-  // Create a statement that converts from the native type of the native member
-  // to a `napi_value`, stored in `js_prop_0`, ...
-  ...dict.members.reduce((soFar, member, idx) => soFar.concat([
-    `  status = ${generateConverter(member.idlType)}::ToJS(`,
-    `      env,`,
-    `      val.${member.name},`,
-    `      &js_prop_${idx});`,
+  ...[ 'ToNative', 'ToJS' ].reduce((soFar, direction) => soFar.concat([
+    `template <>`,
+    `napi_status`,
+    `WebIdlNapi::Converter<${dict.name}>::${direction}(`,
+    `    napi_env env,`,
+    ...(direction === 'ToNative' ? [
+      `    napi_value val,`,
+      `    ${dict.name}* result) {`,
+    ] : [
+      `    const ${dict.name}& val,`,
+      `    napi_value* result) {`,
+    ]),
+    `  ${converter} converter;`,
+    `  napi_status status = converter.Init(env);`,
     `  if (status != napi_ok) return status;`,
-    ``
+    ``,
+    `  return converter.${direction}(env, val, result);`,
+    `}`,
+    ``,
   ]), []),
-  // Create a `napi_property_descriptor` array with a descriptor for each
-  // member.
-  `  napi_property_descriptor props[] =`,
-  generateInitializerList(dict.members.map((member, idx) => [
-    `"${member.name}"`,
-    `nullptr`,
-    `nullptr`,
-    `nullptr`,
-    `nullptr`,
-    `js_prop_${idx}`,
-    `napi_enumerable`,
-    `nullptr`
-  ]), '  ') + ';',
-  ``,
-  // Create the object that will hold the properties, assign the properties, and
-  // return the object by assigning it to `*result`.
-  `  status = napi_create_object(env, &ret);`,
-  `  if (status != napi_ok) return status;`,
-  ``,
-  `  status = napi_define_properties(`,
-  `      env,`,
-  `      ret,`,
-  `      sizeof(props) / sizeof(*props),`,
-  `      props);`,
-  `  if (status != napi_ok) return status;`,
-  ``,
-  `  *result = ret;`,
-  `  return napi_ok;`,
-  `}`,
   ].join('\n');
 }
 
-// Create an initializer list for signature candidates that will be processed by
-// `WebIdlNapi::PickSignature()`. It may look like this:
-// { { true, { napi_number, object } }, { true, { napi_string, napi_object } }
-function generateSigCandidates(sigs) {
-  return generateInitializerList(
-    sigs.map((sig) => [
-      true,
-      sig.arguments.map((arg) =>
-        typemapWebIDLBasicTypesToNAPI[generateNativeType(arg.idlType)].type)
-    ]), '            ');
+// The values of `napi_valuetype` in the order in which they are declared.
+const napiValueTypes = [
+  'napi_undefined', 'napi_null', 'napi_boolean', 'napi_number', 'napi_string',
+  'napi_symbol', 'napi_object', 'napi_function', 'napi_external', 'napi_bigint'
+];
+
+// Determine the `napi_valuetype` a JS value must have in order to be accepted
+// as the given WebIDL type. Enums are passed as strings, typedefs resolve to
+// the type they alias, and everything else not in the typemap is an object.
+function generateNapiType(idlType) {
+  const nativeType = generateBaseType(idlType);
+  if (typemapWebIDLBasicTypesToNAPI[nativeType]) {
+    return typemapWebIDLBasicTypesToNAPI[nativeType].type;
+  }
+  const typedef = tree.find((item) =>
+    (item.type === 'typedef' && item.name === nativeType));
+  if (typedef) {
+    return generateNapiType(typedef.idlType);
+  }
+  if (callbacks[nativeType]) {
+    return 'napi_function';
+  }
+  return (enums.some((item) => (item.name === nativeType))
+    ? 'napi_string'
+    : 'napi_object');
 }
 
-function generateParamRetrieval(sigs, maxArgs, isForConstructor) {
-  if (isForConstructor && maxArgs === 0) {
-    maxArgs = 1;
+// Generate the converter of a callback interface, which accepts a function, or
+// an object on which its single operation is then called. The native type
+// is declared by the implementation as a `WebIdlNapi::Callback<Sig>`.
+function generateCallbackInterfaceConverter(cbIface) {
+  const ops = cbIface.members.filter((item) => (item.type === 'operation'));
+  if (ops.length !== 1 || !ops[0].name) {
+    throw new Error(`Callback interface ${cbIface.name} must have exactly ` +
+      `one regular operation`);
   }
+  return [
+    `struct webidl_napi_callback_interface_${cbIface.name} {`,
+    `  static napi_status ToNative(napi_env env,`,
+    `                              napi_value val,`,
+    `                              ${cbIface.name}* result) {`,
+    `    return result->Reset(env, val, "${ops[0].name}");`,
+    `  }`,
+    `  static napi_status ToJS(napi_env env,`,
+    `                          const ${cbIface.name}& val,`,
+    `                          napi_value* result) {`,
+    `    return val.Value(env, result);`,
+    `  }`,
+    `};`
+  ].join('\n');
+}
+
+// Create the table of signature masks that will be processed by
+// `WebIdlNapi::PickSignature()`, with one row per argument position and one
+// column per `napi_valuetype`. Bit n is set in a column if signature n accepts
+// that type at that position. Optional arguments also accept `undefined`, and
+// nullable ones also accept `null` and `undefined`. For
+// signatures `(unsigned long)` and `(DOMString)` the only row looks like this:
+// { 0x0, 0x0, 0x0, 0x1, 0x2, 0x0, 0x0, 0x0, 0x0, 0x0 }
+function generateSigCandidates(sigs, maxArgs) {
+  if (sigs.length > 32) {
+    throw new Error(`Cannot generate more than 32 overloads for ` +
+      `${sigs[0].name || 'constructor'}`);
+  }
+  const masks = Array.apply(0, Array(maxArgs)).map(() =>
+    napiValueTypes.map(() => 0));
+  sigs.forEach((sig, sigIdx) => sig.arguments.forEach((arg, argIdx) => {
+    const types = [
+      generateNapiType(arg.idlType),
+      ...((arg.optional || arg.idlType.nullable) ? [ 'napi_undefined' ] : []),
+      ...(arg.idlType.nullable ? [ 'napi_null' ] : [])
+    ];
+    types.forEach((type) => {
+      masks[argIdx][napiValueTypes.indexOf(type)] |= (1 << sigIdx);
+    });
+  }));
+  return masks.map((row, idx) =>
+    `{ ${row.map((mask) => `0x${(mask >>> 0).toString(16)}`).join(', ')} }` +
+      (idx < masks.length - 1 ? ',' : ''));
+}
+
+// Create the table of `WebIdlNapi::InterfaceMask`s with which
+// `WebIdlNapi::PickSignature()` tells instances of different interfaces apart.
+// There is one entry for each position and interface, holding the signatures
+// which accept an instance of that interface at that position.
+function generateIfaceMasks(sigs) {
+  const entries = sigs.reduce((soFar, sig, sigIdx) => {
+    sig.arguments.forEach((arg, argIdx) => {
+      const ifname = generateBaseType(arg.idlType);
+      if (!ifaces[ifname]) return;
+      const key = `${argIdx}:${ifname}`;
+      soFar[key] = soFar[key] || { position: argIdx, ifname, signatures: 0 };
+      soFar[key].signatures |= (1 << sigIdx);
+    });
+    return soFar;
+  }, {});
+  return Object.values(entries).map(({ position, ifname, signatures }) =>
+    `{ ${position}, &WebIdlNapi::InterfaceTraits<${ifname}>::type_tag, ` +
+      `0x${(signatures >>> 0).toString(16)} }`);
+}
+
+// The bindings receive the `InstanceData` of the env as the data pointer of
+// their callbacks, so that they need not retrieve it from the env. This casts
+// the pointer retrieved into `data` by `napi_get_cb_info()`.
+function generateCallbackData() {
+  return [
+    `  WebIdlNapi::InstanceData* idata =`,
+    `      static_cast<WebIdlNapi::InstanceData*>(data);`,
+  ];
+}
+
+// Whether the binding must check that the argument is present, or not null,
+// before converting it. An optional dictionary defaulting to `{}` is converted
+// even if it is missing, which gives its members their default values.
+function isCheckedArg(arg) {
+  return ((arg.optional &&
+      !(arg.default && arg.default.type === 'dictionary')) ||
+    !!arg.idlType.nullable);
+}
+
+// Retrieve the receiver and the arguments, and, if there are multiple
+// signatures, pick the one to call. `beforePick` contains lines of code to run
+// between retrieving the arguments and picking the signature. Picking the
+// signature also stores the types of the arguments in `arg_types` if any
+// argument is checked, so that the checks need not retrieve them again. If
+// `needsData` is true, the `InstanceData` of the env is retrieved into `idata`.
+function generateParamRetrieval(sigs, maxArgs, beforePick, needsData) {
+  const keepTypes = (sigs.length > 1 &&
+    sigs.some((sig) => sig.arguments.some(isCheckedArg)));
   return [
     // We declare variable `sig_idx` only if there are multiple signatures.
     ...(sigs.length > 1 ? [ `  int sig_idx = -1;` ] : []),
+    ...(needsData ? [ `  void* data;` ] : []),
     // Declare `argv` and `argc` only if we have arguments.
     ...(maxArgs > 0 ? [
       `  size_t argc = ${maxArgs};`,
       `  napi_value argv[${maxArgs}];`,
     ] : []),
-    // This constructor may be called from native with a single `napi_external`.
-    ...(isForConstructor ? [
-      `  napi_value external = nullptr;`,
-      `  napi_valuetype external_type;`
-    ] : []),
     `  napi_value js_rcv;`,
     `  NAPI_CALL(`,
     `      env,`,
@@ -334,138 +1062,309 @@ function generateParamRetrieval(sigs, maxArgs, isForConstructor) {
       `          nullptr,`,
     ]),
     `          &js_rcv,`,
-    `          nullptr));`,
-    // If this is a constructor, see if the first retrieved argument is of type
-    // `napi_external`. If so, set `external` to it, because a non-`nullptr`
-    // value for `external` will trigger the straight-to-`napi_wrap` special
-    // case.
-    ...(isForConstructor ? [
-      `  NAPI_CALL(env, napi_typeof(env, argv[0], &external_type));`,
-      `  if (external_type == napi_external) external = argv[0];`,
-    ] : []),
+    ...(needsData ? [
+      `          &data));`,
+      ...generateCallbackData(),
+    ] : [
+      `          nullptr));`,
+    ]),
+    ...(beforePick || []),
     // If we have multiple signatures, let's generate the code to figure out
     // which one the JS is trying to call, and then generate the code that
-    // assigns the result to `sig_idx`. However, we need not pick a signature if
-    // `external` is non-null, because then we're down the special code path for
-    // constructing a new object via a `napi_new_instance` call that happened in
-    // another method.
-    ...(sigs.length > 1 ? [
-      // Wrap the `PickSignature` call in an if-statement, but only if this is a
-      // constructor.
-      ...(isForConstructor ? [ `  if (external == nullptr) {` ] : []) ,
-      ...([
-        `    NAPI_CALL(`,
-        `        env,`,
-        `        WebIdlNapi::PickSignature(`,
-        `            env,`,
-        `            argc,`,
-        `            argv,`,
-        `${generateSigCandidates(sigs)},`,
-        `            &sig_idx));`,
-      ]
-      // If we wrap the `PickSignature` call in an if-statement, we must also
-      // indent it by two more spaces.
-      .map((item) => (isForConstructor ? ('  ' + item) : item))),
-      ...(isForConstructor ? [ `  }` ] : []) ,
-    ] : []),
+    // assigns the result to `sig_idx`.
+    ...(sigs.length > 1 ? (() => {
+      const ifaceMasks = generateIfaceMasks(sigs);
+      return [
+        `  static const WebIdlNapi::SignatureMasks sig_masks[${maxArgs}] = {`,
+        ...generateSigCandidates(sigs, maxArgs).map((row) => `    ${row}`),
+        `  };`,
+        ...(ifaceMasks.length > 0 ? [
+          `  static const WebIdlNapi::InterfaceMask iface_masks[] = {`,
+          ifaceMasks.map((row) => `    ${row}`).join(',\n'),
+          `  };`,
+        ] : []),
+        ...(keepTypes ? [ `  napi_valuetype arg_types[${maxArgs}];` ] : []),
+        `  NAPI_CALL(`,
+        `      env,`,
+        `      WebIdlNapi::PickSignature(`,
+        `          env,`,
+        `          argc,`,
+        `          argv,`,
+        `          sig_masks,`,
+        `          0x${((2 ** sigs.length) - 1).toString(16)},`,
+        ...((ifaceMasks.length > 0 || keepTypes) ? [
+          `          &sig_idx,`,
+          (ifaceMasks.length > 0
+            ? `          iface_masks,`
+            : `          nullptr,`),
+          `          ${ifaceMasks.length}` + (keepTypes ? ',' : '));'),
+          ...(keepTypes ? [ `          arg_types));` ] : []),
+        ] : [
+          `          &sig_idx));`,
+        ]),
+      ];
+    })() : []),
     // TODO(gabrielschulhof): What if, upon return, argc is greater than maxArgs?
   ].join('\n');
 }
 
-function generateCall(ifname, sig, indent, sameObjAttrCount) {
-  function argToNativeCall(idlType, index, indent) {
+function generateCall(ifname, sig, indent, sameObjAttrCount, pooled,
+    typesPicked) {
+  // Interface arguments are passed as the native object wrapped by the JS
+  // object, rather than as a copy of it. Required ones are passed by reference,
+  // and optional or nullable ones as a pointer, which is null if the argument
+  // is missing, `undefined`, or `null`.
+  function isInterfaceArg(arg) {
+    return (typeof arg.idlType.idlType === 'string' &&
+      !!ifaces[arg.idlType.idlType]);
+  }
+  function isWrappedArg(arg) {
+    return (isInterfaceArg(arg) && !isCheckedArg(arg));
+  }
+  function isWrappedPointerArg(arg) {
+    return (isInterfaceArg(arg) && isCheckedArg(arg));
+  }
+  function argToNativeCall(idlType, index, indent, target) {
     return [
       `NAPI_CALL(`,
       `    env,`,
       `    ${generateConverter(idlType)}::ToNative(`,
       `        env,`,
       `        argv[${index}],`,
-      `        &native_arg_${index}));`,
+      `        ${target || `&native_arg_${index}`}));`,
     ].map((item) => (indent + item));
   }
+  // A checked argument is converted only if it is present and, if nullable,
+  // not null. Otherwise, it is given its default value, or it remains empty if
+  // its native type is `WebIdlNapi::Optional<T>` or `WebIdlNapi::Nullable<T>`,
+  // or if its default value is that of a default-constructed `T`. The
+  // type of the argument was retrieved while picking the signature, if there
+  // are several, and is retrieved here otherwise, but only if it was passed.
+  function argToCheckedCall(arg, index) {
+    const argType = (typesPicked ? `arg_types[${index}]` : `arg_type_${index}`);
+    const wrapped = isWrappedPointerArg(arg);
+    const isEmptied = (arg.idlType.nullable || !arg.default);
+    const defaultValue = ((arg.default &&
+        ![ 'null', 'sequence' ].includes(arg.default.type))
+      ? generateDefaultValue(arg)
+      : null);
+    return [
+      ...(typesPicked ? [] : [
+        `napi_valuetype arg_type_${index} = napi_undefined;`,
+        `if (argc > ${index}) {`,
+        `  NAPI_CALL(`,
+        `      env,`,
+        `      napi_typeof(`,
+        `          env,`,
+        `          argv[${index}],`,
+        `          &arg_type_${index}));`,
+        `}`,
+      ]),
+      `if (${argType} != napi_undefined` +
+        (arg.idlType.nullable ? ` && ${argType} != napi_null) {` : `) {`),
+      ...(wrapped
+        ? argToWrappedCall(arg.idlType, index).slice(1).map((line) =>
+          `  ${line}`)
+        : argToNativeCall(
+          (isEmptied ? { ...arg.idlType, nullable: false } : arg.idlType),
+          index,
+          '  ',
+          (isEmptied ? `&native_arg_${index}.emplace()` : null))),
+      ...((defaultValue !== null && !wrapped) ? [
+        `} else {`,
+        `  native_arg_${index} = ${defaultValue};`,
+      ] : []),
+      `}`,
+    ];
+  }
+  function argToWrappedCall(idlType, index) {
+    return [
+      `${idlType.idlType}* native_arg_${index};`,
+      `NAPI_CALL(`,
+      `    env,`,
+      `    WebIdlNapi::Wrapping<${idlType.idlType}>::Retrieve(`,
+      `        env,`,
+      `        argv[${index}],`,
+      `        &native_arg_${index}));`,
+    ];
+  }
+  // Generate the arguments: WebIdlNapi::PassArgument(native_arg_0), ... The
+  // converted arguments are not used after the call, so the callee may take
+  // them by value or by rvalue reference, into which they are moved, as well as
+  // by reference.
+  const callArgs = sig.arguments.map((arg, idx) => (isWrappedArg(arg)
+    ? `*native_arg_${idx}`
+    : isWrappedPointerArg(arg)
+      ? `native_arg_${idx}`
+      : `WebIdlNapi::PassArgument(native_arg_${idx})`));
+  // An operation marked [WebIdlNapiAsync] stores the receiver and its converted
+  // arguments in a `WebIdlNapi::AsyncCall`, which calls the native method on
+  // the libuv threadpool. The objects wrapping the receiver and the interface
+  // arguments are kept alive until the call completes.
+  const isAsync = hasExtAttr(sig, 'WebIdlNapiAsync');
+  function generateAsyncCall() {
+    const resultType = generateNativeType(sig.idlType.idlType[0]);
+    const members = [
+      ...(sig.special === 'static' ? [] : [ [ `${ifname}*`, 'cc_rcv' ] ]),
+      ...sig.arguments.map((arg, idx) => [
+        (isInterfaceArg(arg)
+          ? `${arg.idlType.idlType}*`
+          : generateArgType(arg)),
+        `native_arg_${idx}`
+      ])
+    ];
+    const keepAlive = [
+      ...(sig.special === 'static' ? [] : [ 'js_rcv' ]),
+      ...sig.arguments
+        .map((arg, idx) => (isInterfaceArg(arg) ? `argv[${idx}]` : null))
+        .filter((item) => item !== null)
+    ];
+    return [
+      `{`,
+      `  struct Call : public WebIdlNapi::AsyncCall<${resultType}> {`,
+      ...members.map(([type, name]) => `    ${type} ${name};`),
+      `    ${resultType} Execute() override {`,
+      `      return ` +
+        (sig.special === 'static' ? `${ifname}::` : 'cc_rcv->') + sig.name +
+        `(${callArgs.join(', ')});`,
+      `    }`,
+      `  };`,
+      `  Call* call = new Call;`,
+      ...members.map(([type, name]) => ((type.endsWith('*'))
+        ? `  call->${name} = ${name};`
+        : `  call->${name} = std::move(${name});`)),
+      ...(keepAlive.length > 0
+        ? [ `  napi_value keep_alive[] = { ${keepAlive.join(', ')} };` ]
+        : []),
+      `  NAPI_CALL(env,`,
+      `      WebIdlNapi::AsyncCall<${resultType}>::Queue(`,
+      `          env,`,
+      `          call,`,
+      `          "${ifname}.${sig.name}",`,
+      `          ${keepAlive.length},`,
+      `          ${keepAlive.length > 0 ? 'keep_alive' : 'nullptr'},`,
+      `          &js_ret));`,
+      `}`
+    ];
+  }
   return [
-    ...(sig.external != true ? [
-      // Convert arguments to native data types. This assumes that the DOM type
-      // is a real C++ type and that a function named
-      // `WebIdl::Converter<DOM type>::ToNative` exists.
-      ...sig.arguments.reduce((soFar, arg, index) => soFar.concat([
-        `${generateNativeType(arg.idlType)} native_arg_${index};`,
-        // If the argument is optional, we check that we have it first.
-        ...(arg.optional ? [
-          `bool have_arg_${index} = false;`,
-          `{`,
-          `  napi_valuetype val_type;`,
-          `  NAPI_CALL(`,
-          `      env,`,
-          `      napi_typeof(`,
-          `          env,`,
-          `          argv[${index}],`,
-          `          &val_type));`,
-          `  have_arg_${index} = (val_type != napi_undefined);`,
-          `}`,
-          `if (have_arg_${index}) {`,
-          ...argToNativeCall(arg.idlType, index, '  '),
-          `}`,
-        ] : argToNativeCall(arg.idlType, index, '')),
+    // Convert arguments to native data types. This assumes that the DOM type
+    // is a real C++ type and that a function named
+    // `WebIdl::Converter<DOM type>::ToNative` exists.
+    ...sig.arguments.reduce((soFar, arg, index) => soFar.concat(
+      isWrappedArg(arg) ? argToWrappedCall(arg.idlType, index) :
+      isWrappedPointerArg(arg) ? [
+        `${arg.idlType.idlType}* native_arg_${index} = nullptr;`,
+        ...argToCheckedCall(arg, index),
+      ] : [
+        `${generateArgType(arg)} native_arg_${index};`,
+        ...(isCheckedArg(arg)
+          ? argToCheckedCall(arg, index)
+          : argToNativeCall(arg.idlType, index, '')),
       ]), []),
-      ``,
-      // If this is not a static method or a constructor, declare and retrieve the
-      // native instance `cc_rcv` corresponding to the JS instance in `js_rcv`.
-      ...((sig.special !== 'static' && sig.type != 'constructor') ? [
-        `${ifname}* cc_rcv;`,
-        `NAPI_CALL(env,`,
-        `    WebIdlNapi::Wrapping<${ifname}>::Retrieve(env, js_rcv, &cc_rcv));`,
-        ``
-      ] : [])
+    ``,
+    // If this is not a static method or a constructor, declare and retrieve the
+    // native instance `cc_rcv` corresponding to the JS instance in `js_rcv`.
+    // Node.js has checked the receiver's class, so its type tag is not checked.
+    ...((sig.special !== 'static' && sig.type != 'constructor') ? [
+      `${ifname}* cc_rcv;`,
+      `NAPI_CALL(env,`,
+      `    WebIdlNapi::Wrapping<${ifname}>::RetrieveReceiver(`,
+      `        env,`,
+      `        js_rcv,`,
+      `        &cc_rcv));`,
+      ``
     ] : []),
     // A constructor has no return value, but we can hold the new instance in
-    // such a variable if this is a constructor.
-    ...(sig.type === 'constructor' ? [ `${ifname}* ret;` ] : []),
-    ...(sig.external != true ? [
-      // If there's a return value or this is a constructor, assign it to a
-      // variable.
-      (((sig.idlType && sig.idlType.type === 'return-type') ||
-          sig.type === 'constructor') ? 'ret = ' : '') +
-        // If it's a static method, call via `ifname::methodname(...)`. Otherwise,
-        // if it's a constructor, call via `new ifname(...)`. Finally, if it's an
-        // instance method, call via `cc_rcv->methodname(...)`.
-        (sig.special === 'static'
-          ? `${ifname}::`
-          : (sig.type === 'constructor'
-            ? `new ${ifname}`
-            : 'cc_rcv->')) + (sig.type === 'constructor' ? '' : sig.name) + `(` +
-          // Generate the arguments: native_arg_0, native_arg_1, ...
-          Array.apply(0, Array(sig.arguments.length))
-            .map((item, idx) => `native_arg_${idx}`).join(', ') +
-        ');',
-      ] : [
-        `void* external_data;`,
-        `NAPI_CALL(env, napi_get_value_external(env, external, &external_data));`,
-        `ret = static_cast<${ifname}*>(external_data);`,
-      ]),
-      // If this is a constructor, we created the new instance above. Let's wrap
-      // it into the JS object we're constructing.
-      ...(sig.type === 'constructor' ? [
-        `NAPI_CALL(env,`,
-        `    WebIdlNapi::Wrapping<${ifname}>::Create(`,
-        `        env,`,
-        `        js_rcv,`,
-        `        ret,`,
-        `        ${sameObjAttrCount}));`
-      ] : []),
-      // Special handling for promises. We need to call `Conclude()` before
-      // returning to JS to at least create the `napi_deferred` and even resolve
-      // it if the `Promise<T>` was already resolved on the native side.
-      ...((sig.type != 'constructor' && sig.idlType.generic === 'Promise')
-        ? [ `NAPI_CALL(env, ret.Conclude(env));` ]
-        : []),
+    // such a variable if this is a constructor. A pooled constructor holds the
+    // wrapping instead, because it constructs the new instance in the same
+    // block of memory as the wrapping.
+    ...(sig.type === 'constructor' ? [
+      pooled
+        ? `WebIdlNapi::Wrapping<${ifname}>* wrapping;`
+        : `${ifname}* ret;`
+    ] : []),
+    // If there's a return value or this is a constructor, assign it to a
+    // variable.
+    ...((sig.type === 'constructor' && pooled) ? [
+      `NAPI_CALL(env,`,
+      `    WebIdlNapi::Wrapping<${ifname}>::New(`,
+      `        env,`,
+      `        idata,`,
+      `        webidl_napi_interface_${ifname}_slot,`,
+      `        ${sameObjAttrCount},`,
+      ...[ `&wrapping`, ...callArgs ].map((arg, idx, list) =>
+        `        ${arg}` + (idx < list.length - 1 ? ',' : '));'))
+    ] : isAsync ? generateAsyncCall() : [
+    (((sig.idlType && sig.idlType.type === 'return-type') ||
+        sig.type === 'constructor') ? 'ret = ' : '') +
+      // If it's a static method, call via `ifname::methodname(...)`. Otherwise,
+      // if it's a constructor, call via `new ifname(...)`. Finally, if it's an
+      // instance method, call via `cc_rcv->methodname(...)`.
+      (sig.special === 'static'
+        ? `${ifname}::`
+        : (sig.type === 'constructor'
+          ? `new ${ifname}`
+          : 'cc_rcv->')) + (sig.type === 'constructor' ? '' : sig.name) + `(` +
+        callArgs.join(', ') +
+      ');' ]),
+    // If this is a constructor, we created the new instance above. Let's wrap
+    // it into the JS object we're constructing.
+    ...(sig.type === 'constructor' ? (pooled ? [
+      `NAPI_CALL(env,`,
+      `    WebIdlNapi::Wrapping<${ifname}>::Attach(env, js_rcv, wrapping));`
+    ] : [
+      `NAPI_CALL(env,`,
+      `    WebIdlNapi::Wrapping<${ifname}>::Create(`,
+      `        env,`,
+      `        js_rcv,`,
+      `        ret,`,
+      `        ${sameObjAttrCount}));`
+    ]) : []),
+    // Special handling for promises. We need to call `Conclude()` before
+    // returning to JS to at least create the `napi_deferred` and even resolve
+    // it if the `Promise<T>` was already resolved on the native side.
+    ...((sig.type != 'constructor' && sig.idlType.generic === 'Promise' &&
+        !isAsync)
+      ? [ `NAPI_CALL(env, ret.Conclude(env));` ]
+      : []),
     ``
   ]
   .map((item) => ((item == '') ? item : (indent + item)))
   .join('\n');
 }
 
-function generateIfaceOperation(ifname, opname, sigs, sameObjAttrCount) {
+// When `Converter<T>::ToJS` creates a JS object for a native instance, it
+// hands the instance to the constructor via `InstanceData`. In that case, the
+// constructor wraps the instance and skips the selection and the conversion of
+// arguments. For a pooled interface, the pending instance is a wrapping.
+function generatePendingInstance(ifname, sameObjAttrCount, pooled) {
+  const pendingType =
+    (pooled ? `WebIdlNapi::Wrapping<${ifname}>` : ifname);
+  return [
+    `  {`,
+    `    ${pendingType}* pending = static_cast<${pendingType}*>(`,
+    `        idata->TakePendingInstance(webidl_napi_interface_${ifname}_slot));`,
+    `    if (pending != nullptr) {`,
+    ...(pooled ? [
+      `      NAPI_CALL(env,`,
+      `          WebIdlNapi::Wrapping<${ifname}>::Attach(env, js_rcv, pending));`,
+    ] : [
+      `      NAPI_CALL(env,`,
+      `          WebIdlNapi::Wrapping<${ifname}>::Create(`,
+      `              env,`,
+      `              js_rcv,`,
+      `              pending,`,
+      `              ${sameObjAttrCount}));`,
+    ]),
+    `      return nullptr;`,
+    `    }`,
+    `  }`,
+  ];
+}
+
+function generateIfaceOperation(ifname, opname, sigs, sameObjAttrCount,
+    pooled) {
   if (sigs.length === 0) {
     // If we have no signatures, generate a trivial one.
     sigs = [ {
@@ -478,13 +1377,34 @@ function generateIfaceOperation(ifname, opname, sigs, sameObjAttrCount) {
   const maxArgs =
     sigs.reduce((soFar, item) => Math.max(soFar, item.arguments.length), 0);
   const retType = sigs[0].idlType;
-  const hasReturn = (retType && retType.type === 'return-type');
+  // Asynchronous operations set `js_ret` to the promise directly.
+  const isAsync = sigs.some((sig) => hasExtAttr(sig, 'WebIdlNapiAsync'));
+  if (isAsync && (retType.generic !== 'Promise' ||
+      !sigs.every((sig) => hasExtAttr(sig, 'WebIdlNapiAsync')))) {
+    throw new Error(`[WebIdlNapiAsync] on ${ifname}.${opname} requires all ` +
+      `its overloads to be marked and to return a Promise`);
+  }
+  // The arguments and the result of an asynchronous operation cross to the
+  // libuv threadpool, where JS values must not be touched.
+  if (isAsync && sigs.some((sig) => holdsJSValue(sig.idlType.idlType[0]) ||
+      sig.arguments.some((arg) => holdsJSValue(arg.idlType)))) {
+    throw new Error(`[WebIdlNapiAsync] on ${ifname}.${opname} does not ` +
+      `support arguments or results holding JS values, such as \`object\``);
+  }
+  const hasReturn = (retType && retType.type === 'return-type' && !isAsync);
+  // Constructors take pending instances from the `InstanceData`, and returned
+  // instances of interfaces are converted with it.
+  const needsData = (opname === 'constructor' ||
+    (hasReturn && isInterfaceType(retType)));
+  const needsInfo =
+    (maxArgs > 0 || sigs[0].special === '' || needsData || instrument);
 
   return [
     `static napi_value`,
     `webidl_napi_interface_${ifname}_${opname}(`,
     `    napi_env env,`,
-    `    napi_callback_info info) {`,
+    `    napi_callback_info${needsInfo ? ' info' : ''}) {`,
+    ...generateInstrumentation(`${ifname}_${opname}`, 'info'),
     ...(opname === 'constructor' ? [
       `  bool is_construct_call;`,
       `  NAPI_CALL(env,`,
@@ -499,38 +1419,35 @@ function generateIfaceOperation(ifname, opname, sigs, sameObjAttrCount) {
     `  napi_value js_ret = nullptr;`,
     // If we have args or the method is not static then generate the arg
     // retrieval code and decide which signature to call.
-    ...((maxArgs > 0 || sigs[0].special === '') ? [
-      generateParamRetrieval(sigs, maxArgs, opname === 'constructor')
-    ] : []),
-    // Handle the case in a constructor where the `argv[0]` was an external.
-    ...(opname === 'constructor' ? [
-      `  if (external != nullptr) {`,
-      generateCall(ifname,
-                   { type: 'constructor', external: true },
-                   '    ',
-                   sameObjAttrCount),
-      `    return nullptr;`,
-      `  }`,
+    ...(needsInfo ? [
+      generateParamRetrieval(sigs, maxArgs,
+        (opname === 'constructor'
+          ? generatePendingInstance(ifname, sameObjAttrCount, pooled)
+          : []),
+        needsData)
     ] : []),
     // If we have a return value, declare the variable that stores the return
-    // value from the call to the native function.
-    ...(hasReturn ? [ `  ${generateNativeType(retType)} ret;` ] : []),
+    // value from the call to the native function. It is value-initialized,
+    // because the compiler cannot tell that one of the overloads always runs.
+    ...(hasReturn ? [ `  ${generateNativeType(retType)} ret{};` ] : []),
     // If we have multiple signatures we generate calls for each signature and
     // choose at runtime which overload to call via an `if ... else if ...`.
     ...(sigs.length > 1
       ? [ sigs.map((sig, index) => [
           `  if (sig_idx == ${index}) {`,
-          generateCall(ifname, sig, '    ', sameObjAttrCount),
+          generateCall(ifname, sig, '    ', sameObjAttrCount, pooled,
+            sigs.some((item) => item.arguments.some(isCheckedArg))),
           '  }'
         ].join('\n')).join('\n  else\n') ]
-      : [ generateCall(ifname, sigs[0], '  ', sameObjAttrCount) ]),
+      : [ generateCall(ifname, sigs[0], '  ', sameObjAttrCount, pooled) ]),
     // If the op has a return type, compute it and store the resulting
     // `napi_value` in `js_ret`.
     ...(hasReturn ? [
       `  NAPI_CALL(`,
       `      env,`,
-      `      ${generateConverter(retType)}::ToJS(`,
+      `      ${generateToJS(sigs[0])}(`,
       `          env,`,
+      ...(needsData ? [ `          idata,` ] : []),
       `          ret,`,
       `          &js_ret));`,
     ] : []),
@@ -542,17 +1459,21 @@ function generateIfaceOperation(ifname, opname, sigs, sameObjAttrCount) {
 function generateIfaceAttribute(ifname, attribute, sameObjIdx) {
   const nativeAttributeType = generateNativeType(attribute.idlType);
   function generateAccessor(slug) {
+    const needsData = (slug === 'get' && isInterfaceType(attribute.idlType));
     return [
       `static napi_value`,
       `webidl_napi_interface_${ifname}_${slug}_${attribute.name}(`,
       `    napi_env env,`,
       `    napi_callback_info info) {`,
+      ...generateInstrumentation(`${ifname}_${slug}_${attribute.name}`,
+        'info'),
       `  napi_value js_rcv;`,
       `  napi_value result = nullptr;`,
       ...(slug === 'set' ? [
         `  napi_value js_new;`,
         `  size_t argc = 1;`,
       ] : []),
+      ...(needsData ? [ `  void* data;` ] : []),
       `  NAPI_CALL(env,`,
       `      napi_get_cb_info(env,`,
       `          info,`,
@@ -564,23 +1485,32 @@ function generateIfaceAttribute(ifname, attribute, sameObjIdx) {
         `          nullptr,`,
       ]),
       `          &js_rcv,`,
-      `          nullptr));`,
+      (needsData ? `          &data));` : `          nullptr));`),
+      ...(needsData ? generateCallbackData() : []),
       ``,
       `  ${ifname}* cc_rcv;`,
       ...((sameObjIdx >= 0 && slug === 'get') ? [
         `  WebIdlNapi::Wrapping<${ifname}>* wrapping;`,
         `  NAPI_CALL(env,`,
-        `      WebIdlNapi::Wrapping<${ifname}>::Retrieve(`,
+        `      WebIdlNapi::Wrapping<${ifname}>::RetrieveReceiver(`,
         `        env,`,
         `        js_rcv,`,
         `        &cc_rcv,`,
         `        ${sameObjIdx},`,
         `        &result,`,
         `        &wrapping));`,
-        `  if (result != nullptr) return result;`
+        `  if (result != nullptr) return result;`,
+        ...(sameObjectProperty ? [
+          `  napi_value same_obj_key;`,
+          ...generateSameObjectLookup(ifname, sameObjIdx, 'same_obj_key',
+            'result').map((line) => `  ${line}`),
+          `  napi_valuetype result_type;`,
+          `  NAPI_CALL(env, napi_typeof(env, result, &result_type));`,
+          `  if (result_type != napi_undefined) return result;`
+        ] : []),
       ] : [
         `  NAPI_CALL(env,`,
-        `      WebIdlNapi::Wrapping<${ifname}>::Retrieve(`,
+        `      WebIdlNapi::Wrapping<${ifname}>::RetrieveReceiver(`,
         `        env,`,
         `        js_rcv,`,
         `        &cc_rcv));`,
@@ -596,13 +1526,17 @@ function generateIfaceAttribute(ifname, attribute, sameObjIdx) {
       ] : [
         `  NAPI_CALL(`,
         `      env,`,
-        `      ${generateConverter(attribute.idlType)}::ToJS(`,
+        `      ${generateToJS(attribute)}(`,
         `          env,`,
+        ...(needsData ? [ `          idata,` ] : []),
         `          cc_rcv->${attribute.name},`,
         `          &result));`,
-        ...((sameObjIdx >= 0 && slug === 'get') ? [
-          `  NAPI_CALL(env, wrapping->SetRef(env, ${sameObjIdx}, result));`,
-        ] : [])
+        ...((sameObjIdx >= 0 && slug === 'get') ? (sameObjectProperty
+          ? generateSameObjectStore(sameObjIdx, 'same_obj_key', 'result')
+            .map((line) => `  ${line}`)
+          : [
+            `  NAPI_CALL(env, wrapping->SetRef(env, ${sameObjIdx}, result));`,
+          ]) : [])
       ]),
       `  return result;`,
       `}`,
@@ -617,11 +1551,190 @@ function generateIfaceAttribute(ifname, attribute, sameObjIdx) {
   ].join('\n');
 }
 
-function generateIfaceInit(ifname, ops, attributes) {
-  const propCount = Object.keys(ops).length + attributes.length;
+// Generate the `toJSON()` method of an interface marked [WebIdlNapiSnapshot],
+// which returns an object holding the values of all the attributes. It
+// retrieves the native instance once and defines all the properties of the
+// result with a single call. The values of [SameObject] attributes are shared
+// with their accessors.
+function generateIfaceSnapshot(ifname, attributes, sameObjAttrs) {
+  const keys = `webidl_napi_interface_${ifname}_snapshot_keys`;
+  const count = attributes.length;
+  const hasSameObj = attributes.some((item) => sameObjAttrs.includes(item));
+  const needsData =
+    attributes.some((attribute) => isInterfaceType(attribute.idlType));
+  return [
+    ...(count > 0 ? [
+      `static const char* const ${keys}_names[] =`,
+      generateInitializerList(attributes.map(({ name }) => `"${name}"`)) + ';',
+      ``,
+      `static const WebIdlNapi::CachedStrings ${keys}(`,
+      `    ${keys}_names,`,
+      `    ${count});`,
+      ``,
+    ] : []),
+    `static napi_value`,
+    `webidl_napi_interface_${ifname}_toJSON(`,
+    `    napi_env env,`,
+    `    napi_callback_info info) {`,
+    ...generateInstrumentation(`${ifname}_toJSON`, 'info'),
+    `  napi_value js_rcv;`,
+    `  napi_value result;`,
+    ...(needsData ? [
+      `  void* data;`,
+      `  NAPI_CALL(env,`,
+      `      napi_get_cb_info(env, info, nullptr, nullptr, &js_rcv, &data));`,
+      ...generateCallbackData(),
+    ] : [
+      `  NAPI_CALL(env,`,
+      `      napi_get_cb_info(env, info, nullptr, nullptr, &js_rcv, nullptr));`,
+    ]),
+    ``,
+    `  ${ifname}* cc_rcv;`,
+    ...(hasSameObj ? [
+      `  WebIdlNapi::Wrapping<${ifname}>* wrapping;`,
+      `  NAPI_CALL(env,`,
+      `      WebIdlNapi::Wrapping<${ifname}>::RetrieveReceiver(`,
+      `        env,`,
+      `        js_rcv,`,
+      `        &cc_rcv,`,
+      `        -1,`,
+      `        nullptr,`,
+      `        &wrapping));`,
+    ] : [
+      `  NAPI_CALL(env,`,
+      `      WebIdlNapi::Wrapping<${ifname}>::RetrieveReceiver(`,
+      `        env,`,
+      `        js_rcv,`,
+      `        &cc_rcv));`,
+    ]),
+    ``,
+    `  NAPI_CALL(env, napi_create_object(env, &result));`,
+    ...(count > 0 ? [
+      `  napi_value keys[${count}];`,
+      `  NAPI_CALL(env, ${keys}.Get(env, keys));`,
+      ``,
+      `  napi_property_descriptor props[${count}] = {};`,
+      ...attributes.reduce((soFar, attribute, idx) => {
+        const sameObjIdx = sameObjAttrs.indexOf(attribute);
+        const toJS = [
+          `NAPI_CALL(`,
+          `    env,`,
+          `    ${generateToJS(attribute)}(`,
+          `        env,`,
+          ...(isInterfaceType(attribute.idlType) ? [ `        idata,` ] : []),
+          `        cc_rcv->${attribute.name},`,
+          `        &props[${idx}].value));`,
+        ];
+        return soFar.concat([
+          `  props[${idx}].name = keys[${idx}];`,
+          `  props[${idx}].attributes = static_cast<napi_property_attributes>(`,
+          `      napi_writable | napi_enumerable | napi_configurable);`,
+          ...((sameObjIdx >= 0 && sameObjectProperty) ? [
+            `  NAPI_CALL(env,`,
+            `      wrapping->GetRef(env, ${sameObjIdx}, &props[${idx}].value));`,
+            `  if (props[${idx}].value == nullptr) {`,
+            `    napi_value same_obj_key;`,
+            ...generateSameObjectLookup(ifname, sameObjIdx, 'same_obj_key',
+              `props[${idx}].value`).map((line) => `    ${line}`),
+            `    napi_valuetype value_type;`,
+            `    NAPI_CALL(env,`,
+            `        napi_typeof(env, props[${idx}].value, &value_type));`,
+            `    if (value_type == napi_undefined) {`,
+            ...toJS.map((line) => `      ${line}`),
+            ...generateSameObjectStore(sameObjIdx, 'same_obj_key',
+              `props[${idx}].value`).map((line) => `      ${line}`),
+            `    }`,
+            `  }`,
+          ] : sameObjIdx >= 0 ? [
+            `  NAPI_CALL(env,`,
+            `      wrapping->GetRef(env, ${sameObjIdx}, &props[${idx}].value));`,
+            `  if (props[${idx}].value == nullptr) {`,
+            ...toJS.map((line) => `    ${line}`),
+            `    NAPI_CALL(env,`,
+            `        wrapping->SetRef(env, ${sameObjIdx}, props[${idx}].value));`,
+            `  }`,
+          ] : toJS.map((line) => `  ${line}`)),
+        ]);
+      }, []),
+      ``,
+      `  NAPI_CALL(env,`,
+      `      napi_define_properties(env, result, ${count}, props));`,
+    ] : []),
+    `  return result;`,
+    `}`
+  ].join('\n');
+}
+
+// Generate the property descriptors with which the `iterable`, `maplike`, or
+// `setlike` declaration of an interface extends it, if it has one. They are
+// bound by `WebIdlNapi::Iterable<T, type>`, which iterates over the native
+// instance as a container. Only read-only declarations are supported.
+function generateIterableProps(iface) {
+  const decl = iface.members.find((item) =>
+    [ 'iterable', 'maplike', 'setlike' ].includes(item.type));
+  if (!decl) return [];
+  if (decl.async) {
+    throw new Error(`The async iterable declaration of ${iface.name} is not ` +
+      `supported`);
+  }
+  if (decl.type !== 'iterable' && !decl.readonly) {
+    throw new Error(`The ${decl.type} declaration of ${iface.name} must be ` +
+      `readonly`);
+  }
+  const type = ((decl.type === 'setlike')
+    ? 'kSet'
+    : (decl.idlType.length === 2 ? 'kPairs' : 'kIndexed'));
+  const binding = (name) => (`WebIdlNapi::Iterable<${iface.name}, ` +
+    `WebIdlNapi::IterableType::${type}>::${name}`);
+  const method = (name, impl) => ([
+    `"${name}"`,
+    `nullptr`,
+    binding(impl),
+    `nullptr`,
+    `nullptr`,
+    `nullptr`,
+    `static_cast<napi_property_attributes>(napi_enumerable)`,
+    `idata`
+  ]);
+  return [
+    method('entries', 'Entries'),
+    method('keys', 'Keys'),
+    method('values', 'Values'),
+    method('forEach', 'ForEach'),
+    // The default iterator of a map or of pairs yields its entries.
+    [
+      `nullptr`,
+      `iterator_symbol`,
+      binding(type === 'kPairs' ? 'Entries' : 'Values'),
+      `nullptr`,
+      `nullptr`,
+      `nullptr`,
+      `napi_default`,
+      `idata`
+    ],
+    ...(decl.type === 'iterable' ? [] : [
+      [
+        `"size"`,
+        `nullptr`,
+        `nullptr`,
+        binding('Size'),
+        `nullptr`,
+        `nullptr`,
+        `static_cast<napi_property_attributes>(napi_enumerable)`,
+        `idata`
+      ],
+      method('has', 'Has'),
+      ...(decl.type === 'maplike' ? [ method('get', 'Get') ] : [])
+    ])
+  ];
+}
+
+function generateIfaceInit(ifname, ops, attributes, iterableProps) {
+  const propCount =
+    Object.keys(ops).length + attributes.length + iterableProps.length;
   return [
     // Generate the init method that defines the JS class.
-    `static napi_status`,
+    `${sharedLinkage}napi_status`,
     `webidl_napi_create_interface_${ifname}(`,
     `    napi_env env,`,
     `    napi_value* result) {`,
@@ -629,6 +1742,17 @@ function generateIfaceInit(ifname, ops, attributes) {
     `  napi_value ctor;`,
     `  napi_ref ctor_ref;`,
     `  WebIdlNapi::InstanceData* idata;`,
+    ``,
+    `  status = WebIdlNapi::InstanceData::GetCurrent(env, &idata);`,
+    `  if (status != napi_ok) return status;`,
+    ``,
+    ...(iterableProps.length > 0 ? [
+      `  napi_value iterator_symbol;`,
+      `  status = WebIdlNapi::GetIteratorSymbol(env, &iterator_symbol);`,
+      `  if (status != napi_ok) return status;`,
+      ``,
+    ] : []),
+    // The class and each of its properties receive `idata` as their data.
     ...((propCount > 0) ? [
       `  napi_property_descriptor props[] =`,
       generateInitializerList([
@@ -646,7 +1770,7 @@ function generateIfaceInit(ifname, ops, attributes) {
               // Or in `napi_static` for static methods.
               ...(ops[opname][0].special === 'static' ? [ 'napi_static' ] : [])
             ].join(' | ') + ')',
-            `nullptr`
+            `idata`
           ])),
         ...attributes.map((attribute) => ([
           `"${attribute.name}"`,
@@ -658,20 +1782,18 @@ function generateIfaceInit(ifname, ops, attributes) {
             : `webidl_napi_interface_${ifname}_set_${attribute.name}`),
           `nullptr`,
           `static_cast<napi_property_attributes>(napi_enumerable)`,
-          `nullptr`
-        ]))
+          `idata`
+        ])),
+        ...iterableProps
       ], '    ') + ';',
+      ``,
       ] : []),
-    ``,
-    `  status = WebIdlNapi::InstanceData::GetCurrent(env, &idata);`,
-    `  if (status != napi_ok) return status;`,
-    ``,
     `  status = napi_define_class(`,
     `      env,`,
     `      "${ifname}",`,
     `      NAPI_AUTO_LENGTH,`,
     `      webidl_napi_interface_${ifname}_constructor,`,
-    `      nullptr,`,
+    `      idata,`,
     ...((propCount > 0) ? [
       `      sizeof(props) / sizeof(*props),`,
       `      props,`,
@@ -685,48 +1807,87 @@ function generateIfaceInit(ifname, ops, attributes) {
     `  status = napi_create_reference(env, ctor, 1, &ctor_ref);`,
     `  if (status != napi_ok) return status;`,
     ``,
-    `  idata->AddConstructor("${ifname}", ctor_ref);`,
+    `  idata->AddConstructor(webidl_napi_interface_${ifname}_slot, ctor_ref);`,
     `  *result = ctor;`,
     `  return napi_ok;`,
     `}`
   ].join('\n');
 }
 
-function generateIfaceConverters(ifaceName) {
+function generateIfaceConverters(ifaceName, sameObjAttrCount, pooled) {
+  const slot = `webidl_napi_interface_${ifaceName}_slot`;
   return [
-  `template<>`,
-  `napi_status WebIdlNapi::Converter<${ifaceName}>::ToJS(`,
+  `${sharedLinkage}napi_status`,
+  `webidl_napi_create_interface_${ifaceName}(`,
+  `    napi_env env,`,
+  `    napi_value* result);`,
+  ``,
+  `template <>`,
+  `napi_status WebIdlNapi::InterfaceTraits<${ifaceName}>::ToJS(`,
   `    napi_env env,`,
+  `    InstanceData* idata,`,
   `    const ${ifaceName}& val,`,
   `    napi_value* result) {`,
+  ...generateInstrumentation(`${ifaceName}_ToJS`, 'idata'),
   `  napi_status status;`,
-  `  napi_value external, ctor;`,
-  `  InstanceData* idata;`,
-  ``,
-  `  status = InstanceData::GetCurrent(env, &idata);`,
-  `  if (status != napi_ok) return status;`,
+  `  napi_value ctor;`,
   ``,
-  `  ${ifaceName}* local = new ${ifaceName};`,
-  `  *local = val;`,
-  `  status = napi_create_external(env, local, nullptr, nullptr, &external);`,
-  `  if (status != napi_ok) return status;`,
-  ``,
-  `  status = napi_get_reference_value(`,
+  // The class is defined here if it has not been defined in this env yet.
+  `  status = idata->GetConstructor(`,
   `      env,`,
-  `      idata->GetConstructor("${ifaceName}"),`,
+  `      ${slot},`,
+  `      webidl_napi_create_interface_${ifaceName},`,
   `      &ctor);`,
   `  if (status != napi_ok) return status;`,
   ``,
-  `  status = napi_new_instance(env, ctor, 1, &external, result);`,
-  `  if (status != napi_ok) return status;`,
+  // Hand the new native instance to the constructor, which wraps it directly.
+  ...(pooled ? [
+    `  Wrapping<${ifaceName}>* local;`,
+    `  status = Wrapping<${ifaceName}>::New(`,
+    `      env,`,
+    `      idata,`,
+    `      ${slot},`,
+    `      ${sameObjAttrCount},`,
+    `      &local);`,
+    `  if (status != napi_ok) return status;`,
+    `  *local->Get() = val;`,
+  ] : [
+    `  ${ifaceName}* local = new ${ifaceName};`,
+    `  *local = val;`,
+  ]),
+  `  idata->SetPendingInstance(${slot}, local);`,
+  `  status = napi_new_instance(env, ctor, 0, nullptr, result);`,
+  ``,
+  // If the constructor did not take the instance, it never will.
+  `  if (idata->TakePendingInstance(${slot}) != nullptr) {`,
+  (pooled
+    ? `    Wrapping<${ifaceName}>::Free(env, local);`
+    : `    delete local;`),
+  `    if (status == napi_ok) status = napi_generic_failure;`,
+  `  }`,
   `  return status;`,
   `}`,
   ``,
+  // Converters which are not called from the bindings, such as those of
+  // sequences and promises, retrieve the \`InstanceData\` from the env.
+  `template<>`,
+  `napi_status WebIdlNapi::Converter<${ifaceName}>::ToJS(`,
+  `    napi_env env,`,
+  `    const ${ifaceName}& val,`,
+  `    napi_value* result) {`,
+  `  InstanceData* idata;`,
+  `  napi_status status = InstanceData::GetCurrent(env, &idata);`,
+  `  if (status != napi_ok) return status;`,
+  ``,
+  `  return InterfaceTraits<${ifaceName}>::ToJS(env, idata, val, result);`,
+  `}`,
+  ``,
   `template<>`,
   `napi_status WebIdlNapi::Converter<${ifaceName}>::ToNative(`,
   `    napi_env env,`,
   `    napi_value val,`,
   `    ${ifaceName}* result) {`,
+  ...generateInstrumentation(`${ifaceName}_ToNative`),
   `  ${ifaceName}* data;`,
   `  napi_status status =`,
   `      WebIdlNapi::Wrapping<${ifaceName}>::Retrieve(env, val, &data);`,
@@ -751,6 +1912,10 @@ function generateIface(iface) {
   const collapsedCtors =
     iface.members.filter((item) => (item.type === 'constructor'))
 
+  // Instances of a pooled interface are allocated along with their wrappings
+  // from a per-env pool.
+  const pooled = hasExtAttr(iface, 'WebIdlNapiPooled');
+
   const { attrs, sameObjAttrs } =
     iface.members.reduce((soFar, item) => {
       if (item.type === 'attribute') {
@@ -763,31 +1928,149 @@ function generateIface(iface) {
       return soFar;
     }, { attrs: [], sameObjAttrs: [] });
 
+  // The wrapping of each instance holds a reference for each [SameObject]
+  // attribute. If their values are cached on the JS object instead, the
+  // references are only created for objects which cannot hold the values.
+  const sameObjRefCount = sameObjAttrs.length;
+
+  // An interface marked [WebIdlNapiSnapshot] gets a `toJSON()` method which
+  // returns the values of all its attributes, in the order of declaration.
+  const snapshot = hasExtAttr(iface, 'WebIdlNapiSnapshot');
+  if (snapshot && collapsedOps.toJSON) {
+    throw new Error(`[WebIdlNapiSnapshot] on ${iface.name} conflicts with ` +
+      `its toJSON() operation`);
+  }
+  const snapshotAttrs = iface.members.filter((item) =>
+    (attrs.includes(item) || sameObjAttrs.includes(item)));
+
   return [
     [
       `//////////////////////////////////////////////////////////////////////` +
         '//////////',
       `// Interface ${iface.name}`,
       `//////////////////////////////////////////////////////////////////////` +
-        `//////////`
+        `//////////`,
+      ``,
+      // The slot identifies the per-env data of this interface, such as its
+      // constructor, in `WebIdlNapi::InstanceData`.
+      `${sharedLinkage}const size_t webidl_napi_interface_${iface.name}_slot =`,
+      `    WebIdlNapi::InstanceData::NewSlot();`
     ].join('\n'),
     // Object.entries() turns the operations as collapsed by name back into an
     // array of [opname, sigs] tuples, each of which we pass to
     // `generateIfaceOperation`. That way, only one binding is generated for all
     // signatures of an operation.
-    generateIfaceConverters(iface.name),
+    ...((sameObjectProperty && sameObjAttrs.length > 0) ? [
+      [
+        `static const char* const ` +
+          `webidl_napi_interface_${iface.name}_same_obj_keys_names[] =`,
+        generateInitializerList(sameObjAttrs.map(({ name }) =>
+          `"${iface.name}.${name}"`)) + ';',
+        ``,
+        `static const WebIdlNapi::CachedSymbols ` +
+          `webidl_napi_interface_${iface.name}_same_obj_keys(`,
+        `    webidl_napi_interface_${iface.name}_same_obj_keys_names,`,
+        `    ${sameObjAttrs.length});`,
+      ].join('\n')
+    ] : []),
+    generateIfaceConverters(iface.name, sameObjRefCount, pooled),
     generateIfaceOperation(iface.name, 'constructor', collapsedCtors,
-      sameObjAttrs.length),
+      sameObjRefCount, pooled),
     ...Object.entries(collapsedOps).map(([opname, sigs]) =>
       generateIfaceOperation(iface.name, opname, sigs)),
     ...attrs.map((item) => generateIfaceAttribute(iface.name, item)),
     ...sameObjAttrs.map((item, idx) =>
       generateIfaceAttribute(iface.name, item, idx)),
-    generateIfaceInit(iface.name, collapsedOps, [...attrs, ...sameObjAttrs])
+    ...(snapshot
+      ? [ generateIfaceSnapshot(iface.name, snapshotAttrs, sameObjAttrs) ]
+      : []),
+    generateIfaceInit(iface.name,
+      (snapshot
+        ? { ...collapsedOps, toJSON: [ { special: '' } ] }
+        : collapsedOps),
+      [...attrs, ...sameObjAttrs],
+      generateIterableProps(iface))
   ].join('\n\n');
 }
 
-function generateInit(interfaces, moduleName) {
+// With `--lazy-interfaces`, each interface is exported via a getter which
+// defines the class upon first access and then replaces itself with it. The
+// module's initialization only installs the getters where
+// `WebIdlNapi::CanReplaceAccessors()` allows it.
+function generateLazyGetter(ifname) {
+  return [
+    `static napi_value`,
+    `webidl_napi_interface_${ifname}_lazy_get(`,
+    `    napi_env env,`,
+    `    napi_callback_info info) {`,
+    `  napi_value js_rcv;`,
+    `  void* data;`,
+    `  napi_property_descriptor prop =`,
+    generateInitializerList([
+      `"${ifname}"`,
+      `nullptr`,
+      `nullptr`,
+      `nullptr`,
+      `nullptr`,
+      `nullptr`,
+      `napi_enumerable`,
+      `nullptr`
+    ], '    ') + ';',
+    `  NAPI_CALL(env,`,
+    `      napi_get_cb_info(env, info, nullptr, nullptr, &js_rcv, &data));`,
+    ...generateCallbackData(),
+    `  NAPI_CALL(env,`,
+    `      idata->GetConstructor(`,
+    `          env,`,
+    `          webidl_napi_interface_${ifname}_slot,`,
+    `          webidl_napi_create_interface_${ifname},`,
+    `          &prop.value));`,
+    `  NAPI_CALL(env, napi_define_properties(env, js_rcv, 1, &prop));`,
+    `  return prop.value;`,
+    `}`
+  ].join('\n');
+}
+
+// Generate `__webidlNapiStats()`, which returns the statistics recorded by the
+// bindings in instrumented code.
+function generateStats() {
+  return [
+    ...(instrumentedNames.length > 0 ? [
+      `static const char* const webidl_napi_stats_names[] =`,
+      generateInitializerList(instrumentedNames.map((name) => `"${name}"`)) +
+        ';',
+      ``,
+    ] : []),
+    `static napi_value`,
+    `webidl_napi_stats(napi_env env, napi_callback_info) {`,
+    `  napi_value result;`,
+    `  NAPI_CALL(env,`,
+    `      WebIdlNapi::BindingStats::Report(`,
+    `          env,`,
+    `          webidl_napi_stats_slot,`,
+    ...(instrumentedNames.length > 0 ? [
+      `          webidl_napi_stats_names,`,
+      `          ${instrumentedNames.length},`,
+    ] : [
+      `          nullptr,`,
+      `          0,`,
+    ]),
+    `          ${instrumentTiming},`,
+    `          &result));`,
+    `  return result;`,
+    `}`
+  ].join('\n');
+}
+
+function generateInit(interfaces, moduleName, lazy) {
+  const generateEagerInterfaces = (indent) => interfaces.reduce(
+    (soFar, item, idx) => soFar.concat([
+      `  NAPI_CALL(`,
+      `      env,`,
+      `      webidl_napi_create_interface_${item.name}(`,
+      `          env,`,
+      `          &(props[${idx}].value)));`
+    ].map((line) => indent + line)), []);
   return [
     `/////////////////////////////////////////////////////////////////////////` +
       `///////`,
@@ -795,30 +2078,62 @@ function generateInit(interfaces, moduleName) {
     `/////////////////////////////////////////////////////////////////////////` +
       `///////`,
     ``,
+    ...(lazy ? interfaces.reduce((soFar, item) =>
+      soFar.concat([ generateLazyGetter(item.name), `` ]), []) : []),
+    ...(instrument ? [ generateStats(), `` ] : []),
     `napi_value`,
     `${moduleName}_init(`,
     `    napi_env env) {`,
-    // Create an array of property descriptors for each interface.
+    ...((lazy || instrument) ? [
+      `  WebIdlNapi::InstanceData* idata;`,
+      `  NAPI_CALL(env, WebIdlNapi::InstanceData::GetCurrent(env, &idata));`,
+      ...(instrument ? [
+        `  idata->InitStats(webidl_napi_stats_slot, ` +
+          `${instrumentedNames.length});`,
+      ] : []),
+      ``,
+    ] : []),
+    // Create an array of property descriptors for each interface, followed by
+    // the one for `__webidlNapiStats()` if the code is instrumented.
     `  napi_property_descriptor props[] =`,
-    generateInitializerList(interfaces.map((item) => [
+    generateInitializerList([...interfaces.map((item) => [
       `"${item.name}"`,
       `nullptr`,
       `nullptr`,
+      (lazy ? `webidl_napi_interface_${item.name}_lazy_get` : `nullptr`),
       `nullptr`,
       `nullptr`,
+      (lazy
+        ? `static_cast<napi_property_attributes>(` +
+          `napi_enumerable | napi_configurable)`
+        : `napi_enumerable`),
+      (lazy ? `idata` : `nullptr`)
+    ]), ...(instrument ? [ [
+      `"__webidlNapiStats"`,
       `nullptr`,
-      `napi_enumerable`,
+      `webidl_napi_stats`,
+      `nullptr`,
+      `nullptr`,
+      `nullptr`,
+      `napi_default`,
       `nullptr`
-    ]), '  ') + ';',
+    ] ] : []) ], '  ') + ';',
     ``,
-    // Initialize the `value` field of each property descriptor.
-    ...interfaces.reduce((soFar, item, idx) => soFar.concat([
-      `  NAPI_CALL(`,
-      `      env,`,
-      `      webidl_napi_create_interface_${item.name}(`,
-      `          env,`,
-      `          &(props[${idx}].value)));`
-    ]), []),
+    // Initialize the `value` field of each property descriptor, unless the
+    // classes are to be defined lazily. Where the getters cannot replace
+    // themselves, they are instead turned into values up front.
+    ...(lazy ? (interfaces.length === 0 ? [] : [
+      `  bool can_replace;`,
+      `  NAPI_CALL(env, WebIdlNapi::CanReplaceAccessors(env, &can_replace));`,
+      `  if (!can_replace) {`,
+      `    for (size_t idx = 0; idx < ${interfaces.length}; idx++) {`,
+      `      props[idx].getter = nullptr;`,
+      `      props[idx].attributes = napi_enumerable;`,
+      `      props[idx].data = nullptr;`,
+      `    }`,
+      ...generateEagerInterfaces('  '),
+      `  }`,
+    ]) : generateEagerInterfaces('')),
     ``,
     `  napi_value exports;`,
     `  NAPI_CALL(env, napi_create_object(env, &exports));`,
@@ -865,6 +2180,13 @@ const extendedTypedefs = tree.filter((item) =>
 
 const enums = tree.filter((item) => (item.type === 'enum'));
 
+// Save the callbacks and the callback interfaces as objects with properties
+// keyed on their names. Their native types are declared by the implementation.
+const callbacks = tree.reduce((soFar, item) => Object.assign(soFar,
+  (item.type === 'callback') ? { [item.name]: item } : {}), {});
+const callbackIfaces = tree.reduce((soFar, item) => Object.assign(soFar,
+  (item.type === 'callback interface') ? { [item.name]: item } : {}), {});
+
 // Merge inherited dictionaries into their parents.
 Object.values(dicts).forEach((dict) => {
   if (dict.inheritance) {
@@ -897,17 +2219,125 @@ partials.forEach((partial) => {
 const dictionaries = Object.values(dicts);
 const interfaces = Object.values(ifaces);
 
-fs.writeFileSync(outputFile, [
-  [
-    'webidl-napi.h',
-    // If the user requested extra includes, add them as `#include "extra-include.h"`.
-    // argv.i may be absent, may be a string, or it may be an array.
-    ...(argv.i ? (typeof argv.i === 'string' ? [ argv.i ] : argv.i) : [])
-  ].map((item) => `#include "${item}"`).join('\n'),
-  ...[...enums, ...dictionaries, ...interfaces]
-    .map(generateForwardDeclaration),
-  ...enums.map(generateEnumMaps),
-  ...dictionaries.map(generateDictionaryMaps),
-  ...interfaces.map(generateIface),
-  generateInit(interfaces, parsedPath.name)
-].join('\n\n') + '\n');
+const outputPath = path.parse(outputFile);
+const headerFile = path.join(outputPath.dir, `${outputPath.name}.h`);
+const definitions = [...enums, ...dictionaries, ...interfaces];
+function definitionFile(decl) {
+  return path.join(outputPath.dir, `${outputPath.name}-${decl.name}.cc`);
+}
+const generatedFiles = [
+  outputFile,
+  ...(split ? [ headerFile, ...definitions.map(definitionFile) ] : [])
+];
+
+// With `--split`, the names of the generated files are recorded in a manifest
+// next to the output file. The files it lists which are no longer generated,
+// such as those of definitions removed from the IDL, or all of them once
+// `--split` is no longer passed, are deleted, so that the build does not pick
+// them up.
+const manifestFile = path.join(outputPath.dir, `${outputPath.name}.outputs`);
+
+if (argv['list-outputs']) {
+  console.log([ ...generatedFiles, ...(split ? [ manifestFile ] : []) ]
+    .join(';'));
+  process.exit(0);
+}
+
+// Files are rewritten only if their contents change, so that the build does
+// not recompile the files generated for unchanged definitions.
+function writeIfChanged(fileName, contents) {
+  try {
+    if (fs.readFileSync(fileName, { encoding: 'utf-8' }) === contents) return;
+  } catch (error) {
+    if (error.code !== 'ENOENT') throw error;
+  }
+  fs.writeFileSync(fileName, contents);
+}
+
+function removeIfPresent(fileName) {
+  try {
+    fs.unlinkSync(fileName);
+  } catch (error) {
+    if (error.code !== 'ENOENT') throw error;
+  }
+}
+
+function updateManifest() {
+  let previous = [];
+  try {
+    previous = fs.readFileSync(manifestFile, { encoding: 'utf-8' })
+      .split('\n')
+      .filter((name) => (name !== ''))
+      .map((name) => path.join(outputPath.dir, name));
+  } catch (error) {
+    if (error.code !== 'ENOENT') throw error;
+  }
+  previous
+    .filter((fileName) => !generatedFiles.includes(fileName))
+    .forEach(removeIfPresent);
+  if (split) {
+    writeIfChanged(manifestFile, generatedFiles
+      .map((fileName) => path.basename(fileName) + '\n').join(''));
+  } else {
+    removeIfPresent(manifestFile);
+  }
+}
+
+const generatedIncludes = [
+  'webidl-napi.h',
+  // If the user requested extra includes, add them as `#include "extra-include.h"`.
+  // argv.i may be absent, may be a string, or it may be an array.
+  ...(argv.i ? (typeof argv.i === 'string' ? [ argv.i ] : argv.i) : [])
+].map((item) => `#include "${item}"`).join('\n');
+const statsSlot = (instrument ? [
+  `${sharedLinkage}const size_t webidl_napi_stats_slot =\n` +
+    `    WebIdlNapi::InstanceData::NewSlot();`
+] : []);
+
+if (!split) {
+  writeIfChanged(outputFile, [
+    generatedIncludes,
+    ...statsSlot,
+    ...definitions.map(generateForwardDeclaration),
+    ...Object.values(callbackIfaces).map(generateCallbackInterfaceConverter),
+    ...enums.map(generateEnumMaps),
+    ...dictionaries.map(generateDictionaryMaps),
+    ...interfaces.map(generateIface),
+    generateInit(interfaces, parsedPath.name, argv['lazy-interfaces'])
+  ].join('\n\n') + '\n');
+} else {
+  const guard = 'WEBIDL_NAPI_GENERATED_' +
+    outputPath.name.toUpperCase().replace(/[^0-9A-Z]/g, '_') + '_H';
+  const includeHeader = `#include "${path.basename(headerFile)}"`;
+  writeIfChanged(headerFile, [
+    `#ifndef ${guard}\n#define ${guard}`,
+    generatedIncludes,
+    ...(instrument ? [ `extern const size_t webidl_napi_stats_slot;` ] : []),
+    ...definitions.map(generateForwardDeclaration),
+    ...Object.values(callbackIfaces).map(generateCallbackInterfaceConverter),
+    ...interfaces.map((iface) => [
+      `extern const size_t webidl_napi_interface_${iface.name}_slot;`,
+      `napi_status`,
+      `webidl_napi_create_interface_${iface.name}(`,
+      `    napi_env env,`,
+      `    napi_value* result);`
+    ].join('\n')),
+    `#endif  // ${guard}`
+  ].join('\n\n') + '\n');
+  enums.forEach((item) => writeIfChanged(definitionFile(item),
+    [ includeHeader, generateEnumMaps(item) ].join('\n\n') + '\n'));
+  dictionaries.forEach((item) => writeIfChanged(definitionFile(item),
+    [ includeHeader, generateDictionaryMaps(item) ].join('\n\n') + '\n'));
+  interfaces.forEach((item) => writeIfChanged(definitionFile(item), [
+    includeHeader,
+    generateTypeTag(item, false).join('\n'),
+    generateIface(item)
+  ].join('\n\n') + '\n'));
+  writeIfChanged(outputFile, [
+    includeHeader,
+    ...statsSlot,
+    generateInit(interfaces, parsedPath.name, argv['lazy-interfaces'])
+  ].join('\n\n') + '\n');
+}
+
+updateManifest();
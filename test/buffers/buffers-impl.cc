@@ -0,0 +1,86 @@
+#include <string.h>
+#include "buffers-impl.h"
+
+template <typename T>
+static void DeleteElements(napi_env, void* data, void*) {
+  delete[] static_cast<T*>(data);
+}
+
+double BufferOps::sum(const Float64Array& values) {
+  double result = 0;
+  for (size_t idx = 0; idx < values.length(); idx++)
+    result += values.elements()[idx];
+  return result;
+}
+
+unsigned long BufferOps::fill(const Uint8Array& target, unsigned long value) {
+  memset(target.elements(), value, target.length());
+  return target.length();
+}
+
+unsigned long BufferOps::byteLength(const BufferSource& source) {
+  return source.byte_length;
+}
+
+ArrayBuffer BufferOps::createBuffer(unsigned long size) {
+  uint8_t* data = new uint8_t[size];
+  memset(data, 0xff, size);
+  return ArrayBuffer(data,
+                     size,
+                     napi_uint8_array,
+                     DeleteElements<uint8_t>,
+                     nullptr);
+}
+
+ArrayBuffer BufferOps::echo(const ArrayBuffer& source) {
+  return source;
+}
+
+Uint8Array BufferOps::echoView(const Uint8Array& source) {
+  return source;
+}
+
+Float32Array BufferOps::createRamp(unsigned long length) {
+  float* elements = new float[length];
+  for (unsigned long idx = 0; idx < length; idx++)
+    elements[idx] = idx;
+  return Float32Array(elements, length, DeleteElements<float>, nullptr);
+}
+
+double BufferOps::sumSequence(const WebIdlNapi::sequence<double>& values) {
+  double result = 0;
+  for (double value: values)
+    result += value;
+  return result;
+}
+
+WebIdlNapi::sequence<float>
+BufferOps::halve(const WebIdlNapi::sequence<double>& values) {
+  WebIdlNapi::sequence<float> result;
+  for (double value: values)
+    result.push_back(value / 2);
+  return result;
+}
+
+WebIdlNapi::sequence<double>
+BufferOps::twice(const WebIdlNapi::sequence<double>& values) {
+  WebIdlNapi::sequence<double> result;
+  for (double value: values)
+    result.push_back(value * 2);
+  return result;
+}
+
+WebIdlNapi::sequence<unsigned long>
+BufferOps::truncate(const WebIdlNapi::sequence<unsigned long>& values) {
+  return values;
+}
+
+object BufferOps::pick(const WebIdlNapi::sequence<object>& list,
+                       unsigned long index) {
+  return list.at(index);
+}
+
+object BufferOps::pickTagged(const WebIdlNapi::sequence<Tagged>& list,
+                             unsigned long index) {
+  return list.at(index).value;
+}
@@ -0,0 +1,35 @@
+#ifndef WEBIDL_NAPI_TEST_BUFFERS_BUFFERS_IMPL_H
+#define WEBIDL_NAPI_TEST_BUFFERS_BUFFERS_IMPL_H
+
+#include "webidl-napi.h"
+
+struct Tagged {
+  DOMString tag;
+  object value;
+};
+
+class BufferOps {
+ public:
+  double sum(const Float64Array& values);
+  unsigned long fill(const Uint8Array& target, unsigned long value);
+  unsigned long byteLength(const BufferSource& source);
+  ArrayBuffer createBuffer(unsigned long size);
+  ArrayBuffer echo(const ArrayBuffer& source);
+  Uint8Array echoView(const Uint8Array& source);
+  Float32Array createRamp(unsigned long length);
+  double sumSequence(const WebIdlNapi::sequence<double>& values);
+  WebIdlNapi::sequence<float> halve(const WebIdlNapi::sequence<double>& values);
+  WebIdlNapi::sequence<double> twice(const WebIdlNapi::sequence<double>& values);
+  WebIdlNapi::sequence<unsigned long>
+  truncate(const WebIdlNapi::sequence<unsigned long>& values);
+  object pick(const WebIdlNapi::sequence<object>& list, unsigned long index);
+  object pickTagged(const WebIdlNapi::sequence<Tagged>& list,
+                    unsigned long index);
+  WebIdlNapi::FrozenArray<unsigned long> counts{1, 2, 3};
+  // Backs a new `ArrayBuffer` upon each access.
+  ArrayBuffer shared{shared_bytes, sizeof(shared_bytes)};
+ private:
+  uint8_t shared_bytes[4] = {1, 2, 3, 4};
+};
+
+#endif  // WEBIDL_NAPI_TEST_BUFFERS_BUFFERS_IMPL_H
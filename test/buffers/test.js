@@ -0,0 +1,101 @@
+'use strict';
+const assert = require('assert');
+test(require('bindings')({ bindings: 'buffers', module_root: __dirname }));
+
+function test(binding) {
+  const ops = new binding.BufferOps();
+
+  assert.strictEqual(ops.sum(new Float64Array([1.5, 2.5, 3])), 7);
+  assert.throws(() => ops.sum(new Float32Array([1, 2])));
+  assert.throws(() => ops.sum([1, 2]));
+
+  // The native side writes directly into the memory backing the JS array.
+  const bytes = new Uint8Array(16);
+  assert.strictEqual(ops.fill(bytes.subarray(4, 12), 7), 8);
+  assert.deepStrictEqual([...bytes],
+                         [0, 0, 0, 0, 7, 7, 7, 7, 7, 7, 7, 7, 0, 0, 0, 0]);
+
+  assert.strictEqual(ops.byteLength(new ArrayBuffer(10)), 10);
+  assert.strictEqual(ops.byteLength(new Uint16Array(10)), 20);
+  assert.strictEqual(ops.byteLength(new DataView(new ArrayBuffer(12), 4)), 8);
+  assert.throws(() => ops.byteLength({}));
+
+  const buffer = ops.createBuffer(4);
+  assert(buffer instanceof ArrayBuffer);
+  assert.deepStrictEqual([...new Uint8Array(buffer)], [255, 255, 255, 255]);
+
+  // The first buffer returned for memory is external, and later ones, returned
+  // while it is still alive, are copies.
+  const shared = ops.shared;
+  assert.notStrictEqual(ops.shared, shared);
+  new Uint8Array(shared)[0] = 5;
+  assert.deepStrictEqual([...new Uint8Array(ops.shared)], [5, 2, 3, 4]);
+  new Uint8Array(ops.shared)[0] = 6;
+  assert.deepStrictEqual([...new Uint8Array(shared)], [5, 2, 3, 4]);
+
+  // Memory received from JS is copied when it is returned, so that the result
+  // remains valid once the buffer it came from is collected.
+  testEcho(ops);
+
+  const ramp = ops.createRamp(5);
+  assert(ramp instanceof Float32Array);
+  assert.deepStrictEqual([...ramp], [0, 1, 2, 3, 4]);
+
+  // Sequences of numbers can be read from typed arrays of any numeric type.
+  assert.strictEqual(ops.sumSequence([1, 2, 3.5]), 6.5);
+  assert.strictEqual(ops.sumSequence(new Float64Array([1, 2, 3.5])), 6.5);
+  assert.strictEqual(ops.sumSequence(new Int16Array([-1, 2, 3])), 4);
+  assert.strictEqual(ops.sumSequence(new Uint8Array(0)), 0);
+  // Floating-point elements which a cast to an integer could not represent
+  // are converted one by one, like the elements of an array.
+  const unrepresentable = [ NaN, Infinity, -Infinity, 1e300, -1, 3.9, -0.5 ];
+  assert.deepStrictEqual(ops.truncate(new Float64Array(unrepresentable)),
+    ops.truncate(unrepresentable));
+  assert.deepStrictEqual(ops.truncate(new Float32Array([ 1.5, 2.5 ])), [ 1, 2 ]);
+  assert.deepStrictEqual(ops.truncate(new Int8Array([ 1, 2 ])), [ 1, 2 ]);
+
+  // Sequences marked [WebIdlNapiTypedArray] are returned as typed arrays.
+  const halves = ops.halve(new Float64Array([1, 3, 5]));
+  assert(halves instanceof Float32Array);
+  assert.deepStrictEqual([...halves], [0.5, 1.5, 2.5]);
+  assert(ops.counts instanceof Uint32Array);
+  assert.deepStrictEqual([...ops.counts], [1, 2, 3]);
+
+  // Long sequences are converted in several chunks of handle scopes.
+  const long = Array.from({ length: 1000 }, (_, idx) => idx);
+  assert.strictEqual(ops.sumSequence(long), 499500);
+  assert.deepStrictEqual(ops.twice(long), long.map((item) => item * 2));
+
+  // Elements of a sequence of objects remain valid after conversion.
+  const objects = long.map((idx) => ({ idx }));
+  assert.strictEqual(ops.pick(objects, 0), objects[0]);
+  assert.strictEqual(ops.pick(objects, 999), objects[999]);
+
+  // So do the objects held by the dictionaries in a sequence.
+  const tagged = objects.map((value) => ({ tag: 'item', value }));
+  assert.strictEqual(ops.pickTagged(tagged, 0), objects[0]);
+  assert.strictEqual(ops.pickTagged(tagged, 999), objects[999]);
+
+  // Release the native memory behind the buffers created above.
+  global.gc();
+}
+
+function testEcho(ops) {
+  const echo = (() => {
+    const source = new Uint8Array([1, 2, 3, 4]);
+    const result = ops.echo(source.buffer);
+    assert.notStrictEqual(result, source.buffer);
+    source[0] = 5;
+    return result;
+  })();
+  const echoView = (() => {
+    const source = new Uint8Array([6, 7, 8]);
+    const result = ops.echoView(source);
+    assert(result instanceof Uint8Array);
+    source[0] = 9;
+    return result;
+  })();
+  global.gc();
+  assert.deepStrictEqual([...new Uint8Array(echo)], [1, 2, 3, 4]);
+  assert.deepStrictEqual([...echoView], [6, 7, 8]);
+}
@@ -1,13 +1,15 @@
 'use strict';
 const { spawnSync } = require('child_process');
-const { readdirSync, lstatSync } = require('fs');
+const { existsSync, readdirSync, lstatSync } = require('fs');
 const path = require('path');
 const repoRoot = require('bindings').getRoot('.');
 const cmakeJs = path.join(repoRoot, 'node_modules', '.bin', 'cmake-js');
 
 readdirSync(__dirname).forEach((item) => {
   const testDir = path.join(__dirname, item);
-  if (lstatSync(testDir).isDirectory()) {
+  // Tests of the generator alone have no add-on to build.
+  if (lstatSync(testDir).isDirectory() &&
+      existsSync(path.join(testDir, 'CMakeLists.txt'))) {
     const child = spawnSync(cmakeJs, ['compile'], {
       cwd: testDir,
       stdio: 'inherit',
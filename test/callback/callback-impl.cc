@@ -0,0 +1,59 @@
+#include <chrono>
+#include <thread>
+#include "callback-impl.h"
+
+// If the callback throws, the exception propagates to JS once we return.
+DOMString EventSource::transform(Transform callback, DOMString value) {
+  DOMString result;
+  if (callback.CallWithResult(&result, value) != napi_ok) return DOMString();
+  return result;
+}
+
+unsigned long EventSource::dispatch(EventListener listener, DOMString type) {
+  return (listener.Call(type) == napi_ok ? 1 : 0);
+}
+
+// Both calls are posted before the JS thread can make either, so they are made
+// together once we return.
+unsigned long EventSource::dispatchLater(EventListener first,
+                                         EventListener second,
+                                         DOMString type) {
+  first.Post(type);
+  second.Post(type);
+  return 2;
+}
+
+// The messages are delivered in a single call after we return.
+unsigned long
+EventSource::report(ErrorsCallback callback, sequence<DOMString> messages) {
+  for (const DOMString& message: messages) callback.Append(message);
+  return messages.size();
+}
+
+// The calls posted by the thread are made before the promise is resolved,
+// because they are queued first. The thread waits for the promise to be
+// returned to JS, because until then it would be resolved synchronously.
+Promise<unsigned long>
+EventSource::progressFromThread(ProgressCallback callback,
+                                unsigned long total) {
+  Promise<unsigned long> promise;
+  std::thread([callback, promise, total]() mutable {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    for (unsigned long done = 1; done <= total; done++)
+      callback.Post(done, total);
+    promise.Resolve(total);
+  }).detach();
+  return promise;
+}
+
+Promise<unsigned long>
+EventSource::errorsFromThread(ErrorsCallback callback, unsigned long count) {
+  Promise<unsigned long> promise;
+  std::thread([callback, promise, count]() mutable {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    for (unsigned long idx = 0; idx < count; idx++)
+      callback.Append("error " + std::to_string(idx));
+    promise.Resolve(count);
+  }).detach();
+  return promise;
+}
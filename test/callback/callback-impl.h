@@ -0,0 +1,26 @@
+#ifndef WEBIDL_NAPI_TEST_CALLBACK_CALLBACK_IMPL_H
+#define WEBIDL_NAPI_TEST_CALLBACK_CALLBACK_IMPL_H
+
+#include "webidl-napi.h"
+
+using namespace WebIdlNapi;
+
+typedef Callback<DOMString(DOMString)> Transform;
+typedef Callback<void(unsigned long, unsigned long)> ProgressCallback;
+typedef Callback<void(sequence<DOMString>)> ErrorsCallback;
+typedef Callback<void(DOMString)> EventListener;
+
+struct EventSource {
+  DOMString transform(Transform callback, DOMString value);
+  unsigned long dispatch(EventListener listener, DOMString type);
+  unsigned long dispatchLater(EventListener first,
+                              EventListener second,
+                              DOMString type);
+  unsigned long report(ErrorsCallback callback, sequence<DOMString> messages);
+  Promise<unsigned long> progressFromThread(ProgressCallback callback,
+                                            unsigned long total);
+  Promise<unsigned long> errorsFromThread(ErrorsCallback callback,
+                                          unsigned long count);
+};
+
+#endif  // WEBIDL_NAPI_TEST_CALLBACK_CALLBACK_IMPL_H
@@ -0,0 +1,104 @@
+'use strict';
+const assert = require('assert');
+test(require('bindings')({ bindings: 'callback', module_root: __dirname }))
+  .catch((error) => {
+    console.error(error);
+    process.exitCode = 1;
+  });
+
+async function test(binding) {
+  const source = new binding.EventSource();
+
+  // Callbacks are called synchronously on the JS thread, with `undefined` as
+  // their receiver, and their result is converted back.
+  assert.strictEqual(source.transform(function(value) {
+    assert.strictEqual(this, undefined);
+    return value.toUpperCase();
+  }, 'abc'), 'ABC');
+  assert.throws(() => source.transform({}, 'abc'), {
+    code: 'napi_function_expected'
+  });
+  assert.throws(() => source.transform(() => { throw new Error('oops'); }, ''),
+    /^Error: oops$/);
+
+  // A callback interface may be implemented by an object, on which its
+  // operation is called, or by a function.
+  const types = [];
+  const listener = {
+    handleEvent(type) {
+      assert.strictEqual(this, listener);
+      types.push(type);
+    }
+  };
+  assert.strictEqual(source.dispatch(listener, 'load'), 1);
+  assert.strictEqual(source.dispatch((type) => types.push(`${type}!`), 'load'),
+    1);
+  assert.deepStrictEqual(types, [ 'load', 'load!' ]);
+  // The operation is looked up when the call is made.
+  assert.strictEqual(source.dispatch({}, 'load'), 0);
+  assert.throws(() => source.dispatch('load', 'load'), {
+    code: 'napi_object_expected'
+  });
+
+  // Items appended on the JS thread are delivered in a single call once the
+  // binding has returned.
+  const reported = [];
+  assert.strictEqual(source.report((messages) => reported.push(messages),
+    [ 'a', 'b', 'c' ]), 3);
+  assert.deepStrictEqual(reported, []);
+  while (reported.length === 0) {
+    await new Promise((resolve) => setImmediate(resolve));
+  }
+  assert.deepStrictEqual(reported, [ [ 'a', 'b', 'c' ] ]);
+
+  // Calls posted from another thread are made on the JS thread in order,
+  // before the promise resolved after them.
+  const progress = [];
+  assert.strictEqual(await source.progressFromThread(
+    (done, total) => progress.push([ done, total ]), 100), 100);
+  assert.deepStrictEqual(progress,
+    Array.from({ length: 100 }, (_, idx) => [ idx + 1, 100 ]));
+
+  // An exception thrown by a posted call is reported as uncaught, and the
+  // calls after it are still made.
+  const uncaught = [];
+  const onUncaught = (error) => uncaught.push(error.message);
+  process.on('uncaughtException', onUncaught);
+  const made = [];
+  await source.progressFromThread((done) => {
+    made.push(done);
+    if (done === 1) throw new Error('first');
+  }, 2);
+  process.removeListener('uncaughtException', onUncaught);
+  assert.deepStrictEqual(uncaught, [ 'first' ]);
+  assert.deepStrictEqual(made, [ 1, 2 ]);
+
+  // A posted call which fails without throwing, such as one to an object
+  // lacking the operation, is reported as uncaught as well, and does not
+  // prevent the call posted after it in the same turn from being made.
+  const codes = [];
+  const onFailure = (error) => codes.push(error.code);
+  process.on('uncaughtException', onFailure);
+  const later = [];
+  assert.strictEqual(source.dispatchLater({}, (type) => later.push(type),
+    'load'), 2);
+  while (later.length === 0) {
+    await new Promise((resolve) => setImmediate(resolve));
+  }
+  process.removeListener('uncaughtException', onFailure);
+  assert.deepStrictEqual(codes, [ 'napi_function_expected' ]);
+  assert.deepStrictEqual(later, [ 'load' ]);
+
+  // Items appended from another thread are coalesced into fewer calls.
+  const batches = [];
+  const count = 10000;
+  assert.strictEqual(await source.errorsFromThread(
+    (messages) => batches.push(messages), count), count);
+  assert.ok(batches.length < count);
+  assert.deepStrictEqual([].concat(...batches),
+    Array.from({ length: count }, (_, idx) => `error ${idx}`));
+
+  // The references to the callbacks are released once the native copies are
+  // gone, including those released on other threads.
+  global.gc();
+}
@@ -39,6 +39,34 @@ Incrementor::Incrementor(unsigned long initial_value): props{"blah", 42} {
 
 unsigned long Incrementor::increment() { return ++(val->val); }
 
+unsigned long Incrementor::incrementBy(unsigned long amount) {
+  return (val->val += amount);
+}
+
+unsigned long Incrementor::step(Step& options) {
+  return (val->val += options.amount * options.times);
+}
+
 Decrementor Incrementor::getDecrementor() { return Decrementor(*this); }
 
+unsigned long
+Incrementor::totalCount(WebIdlNapi::sequence<Properties>&& list) {
+  unsigned long result = 0;
+  for (const Properties& item: list)
+    result += item.count;
+  return result;
+}
+
 Incrementor::~Incrementor() { val->Unref(); }
+
+unsigned long Incrementor::identify(Properties&& props) { return 0; }
+
+unsigned long Incrementor::identify(Decrementor& dec) { return 1; }
+
+double Incrementor::address() {
+  return static_cast<double>(reinterpret_cast<uintptr_t>(this));
+}
+
+double Incrementor::addressOf(Incrementor* other) {
+  return static_cast<double>(reinterpret_cast<uintptr_t>(other));
+}
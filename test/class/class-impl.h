@@ -11,6 +11,12 @@ struct Properties {
   unsigned long count;
 };
 
+// The defaults given in the IDL are applied by the bindings.
+struct Step {
+  unsigned long amount;
+  unsigned long times;
+};
+
 class Decrementor {
  public:
   void operator=(const Decrementor& other);
@@ -28,11 +34,21 @@ class Incrementor {
   Incrementor(unsigned long initial);
   Incrementor(DOMString initial);
   unsigned long increment();
+  unsigned long incrementBy(unsigned long amount);
+  unsigned long step(Step& options);
 
   Properties props;
   Properties settableProps;
 
   Decrementor getDecrementor();
+  unsigned long totalCount(WebIdlNapi::sequence<Properties>&& list);
+  // Returns the index of the overload which was called.
+  unsigned long identify(Properties&& props);
+  unsigned long identify(Decrementor& dec);
+  // Returns the address of the instance, so that JS can tell reused blocks.
+  double address();
+  // Returns the address of `other`, or 0 if it is null.
+  double addressOf(Incrementor* other);
   friend class Decrementor;
   ~Incrementor();
  private:
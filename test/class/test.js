@@ -1,7 +1,43 @@
 'use strict';
 const buildType = process.config.target_defaults.default_configuration;
 const assert = require('assert');
-test(require('bindings')({ bindings: 'class', module_root: __dirname }));
+const v8 = require('v8');
+const load = (bindings) => require('bindings')({
+  bindings,
+  module_root: __dirname
+});
+
+// The bindings generated with `--instrument-timing` and linked against the
+// runtime library behave like the default ones.
+for (const name of [ 'class', 'class_instrumented', 'class_runtime' ]) {
+  test(load(name));
+}
+testStats(load('class_instrumented'));
+testSameObjectProperty(load('class_same_object'));
+
+// Each env has its own classes, which the bindings reach through the data
+// pointers of their callbacks, so the same tests pass in a worker.
+let workerThreads = null;
+try {
+  workerThreads = require('worker_threads');
+} catch (error) {
+  // Node.js 10 provides workers only with --experimental-worker.
+}
+if (workerThreads && workerThreads.isMainThread) {
+  new workerThreads.Worker(__filename).on('error', (error) => {
+    console.error(error);
+    process.exitCode = 1;
+  });
+}
+
+// Whether two objects have the same hidden class. Natives syntax is enabled
+// only while compiling the check, rather than for the whole test.
+function haveSameMap(a, b) {
+  v8.setFlagsFromString('--allow-natives-syntax');
+  const check = new Function('a', 'b', 'return %HaveSameMap(a, b);');
+  v8.setFlagsFromString('--no-allow-natives-syntax');
+  return check(a, b);
+}
 
 function test(binding) {
   {
@@ -17,18 +53,167 @@ function test(binding) {
     const expectedNewValue = { name: "new name", count: 99 };
     inc.settableProps = expectedNewValue;
     assert.deepStrictEqual(inc.settableProps, expectedNewValue);
+
+    // `Properties` is marked [WebIdlNapiFastShape], so its members always
+    // appear in declaration order, and all the objects returned for it share
+    // the same hidden class, unlike one created in another order.
+    assert.deepStrictEqual(Object.keys(inc.settableProps), ['name', 'count']);
+    const first = inc.settableProps;
+    inc.settableProps = { count: 5, name: 'reordered' };
+    const second = inc.settableProps;
+    assert.ok(haveSameMap(first, second));
+    const other = new binding.Incrementor(1);
+    other.settableProps = { name: 'other', count: 7 };
+    assert.ok(haveSameMap(second, other.settableProps));
+    assert.ok(!haveSameMap(first, { count: 99, name: 'new name' }));
+
+    // Property keys are cached after the first conversion, so make sure they
+    // survive garbage collection and remain usable for later conversions.
+    global.gc();
+    for (let idx = 0; idx < 100; idx++) {
+      const newValue = { name: `name ${idx}`, count: idx };
+      inc.settableProps = newValue;
+      assert.deepStrictEqual(inc.settableProps, newValue);
+    }
+  }
+  {
+    // `Incrementor` is marked [WebIdlNapiSnapshot], so `toJSON()` returns all
+    // its attributes at once, sharing the values of [SameObject] attributes.
+    const inc = new binding.Incrementor(7);
+    inc.settableProps = { name: 'snap', count: 3 };
+    const snapshot = inc.toJSON();
+    assert.deepStrictEqual(Object.keys(snapshot), ['props', 'settableProps']);
+    assert.strictEqual(snapshot.props, inc.props);
+    assert.deepStrictEqual(snapshot.settableProps, { name: 'snap', count: 3 });
+    assert.strictEqual(inc.toJSON().props, snapshot.props);
+    assert.deepStrictEqual(JSON.parse(JSON.stringify(inc)), snapshot);
+
+    // The [SameObject] value is also shared when the snapshot is taken first.
+    const fresh = new binding.Incrementor(8);
+    assert.strictEqual(fresh.toJSON().props, fresh.props);
   }
   {
     assert.strictEqual((new binding.Incrementor(12)).increment(), 13);
     assert.strictEqual((new binding.Incrementor()).increment(), 1);
     assert.strictEqual((new binding.Incrementor('5')).increment(), 6);
+
+    // Operations with a single signature are bound without overload
+    // resolution, which leaves their behavior unchanged.
+    const inc = new binding.Incrementor(2);
+    assert.strictEqual(inc.incrementBy(5), 7);
+    assert.strictEqual(inc.increment(), 8);
+    assert.throws(() => inc.incrementBy('5'), { code: 'napi_number_expected' });
+    assert.throws(() => inc.incrementBy(), { code: 'napi_number_expected' });
+    assert.throws(() => binding.Incrementor.prototype.incrementBy.call({}, 1),
+      TypeError);
+
+    // No signature accepts two arguments, so no native instance is created.
+    assert.throws(() => (new binding.Incrementor(1, 2)).increment());
   }
   {
     const inc = new binding.Incrementor(39);
     const dec = inc.getDecrementor();
     assert.strictEqual(inc.increment(), 40);
     assert.strictEqual(dec.decrement(), 39);
+    assert.ok(dec instanceof binding.Decrementor);
+
+    // Returned objects are constructed natively, and all of them share the
+    // value of the incrementor that produced them.
+    const decs = [];
+    for (let idx = 0; idx < 100; idx++) decs.push(inc.getDecrementor());
+    assert.ok(decs.every((item) => item instanceof binding.Decrementor));
+    assert.strictEqual(decs[0].decrement(), 38);
+    assert.strictEqual(decs[99].decrement(), 37);
+  }
+  {
+    // Wrapped objects carry the type tag of their interface where N-API 8 is
+    // available, so instances of one interface are not taken for another, and
+    // overloads accepting an interface are preferred for its instances.
+    const inc = new binding.Incrementor(3);
+    const dec = inc.getDecrementor();
+    assert.strictEqual(inc.identify({ name: 'plain', count: 1 }), 0);
+    if (Number(process.versions.napi) >= 8) {
+      assert.strictEqual(inc.identify(dec), 1);
+      assert.throws(() => new binding.Decrementor(dec),
+        { code: 'napi_invalid_arg' });
+    }
+    assert.strictEqual(new binding.Decrementor(inc).decrement(), 2);
+
+    // Methods reject receivers of the wrong class before the binding runs.
+    assert.throws(() => binding.Incrementor.prototype.increment.call(dec),
+      TypeError);
+
+    // Accessors are not checked by Node.js, and reject such receivers as well.
+    // Before Node.js 12 they are native data properties, without a getter.
+    if (Number(process.versions.node.split('.')[0]) >= 12) {
+      const { get } = Object.getOwnPropertyDescriptor(
+        binding.Incrementor.prototype,
+        'props');
+      assert.strictEqual(get.call(inc), inc.props);
+      assert.throws(() => get.call(dec), { code: 'napi_invalid_arg' });
+      assert.throws(() => get.call({}), { code: 'napi_invalid_arg' });
+    }
+  }
+  {
+    // Converted arguments are moved into the native call.
+    const inc = new binding.Incrementor();
+    assert.strictEqual(inc.totalCount([
+      { name: 'a', count: 1 },
+      { name: 'b', count: 2 },
+      { name: 'c', count: 3 }
+    ]), 6);
+    assert.strictEqual(inc.totalCount([]), 0);
+
+    // Required members must be present, and the others may be absent.
+    assert.throws(() => inc.totalCount([{ name: 'a' }]),
+      { code: 'napi_invalid_arg' });
+    assert.throws(() => inc.totalCount([{ name: 'a', count: undefined }]),
+      { code: 'napi_invalid_arg' });
+    assert.strictEqual(inc.totalCount([{ count: 4 }, { count: 5 }]), 9);
+
+    // Optional and nullable interface arguments are passed as a pointer to the
+    // wrapped instance, which is null if the argument is missing or null.
+    const other = new binding.Incrementor();
+    assert.strictEqual(inc.addressOf(inc), inc.address());
+    assert.strictEqual(inc.addressOf(other), other.address());
+    assert.strictEqual(inc.addressOf(), 0);
+    assert.strictEqual(inc.addressOf(undefined), 0);
+    assert.strictEqual(inc.addressOf(null), 0);
   }
+  {
+    // Absent members take their default values, and so do all the members of
+    // an absent dictionary.
+    const inc = new binding.Incrementor(0);
+    assert.strictEqual(inc.step(), 1);
+    assert.strictEqual(inc.step({}), 2);
+    assert.strictEqual(inc.step(null), 3);
+    assert.strictEqual(inc.step({ amount: 2 }), 5);
+    assert.strictEqual(inc.step({ times: 3 }), 8);
+    assert.strictEqual(inc.step({ amount: 2, times: 3, other: 1 }), 14);
+    assert.strictEqual(inc.step(Object.create({ amount: 10 })), 24);
+    assert.strictEqual(inc.step({ amount: undefined, times: 2 }), 26);
+    assert.throws(() => inc.step({ amount: 'x' }),
+      { code: 'napi_number_expected' });
+    assert.throws(() => inc.step(5), { code: 'napi_object_expected' });
+  }
+  {
+    // Both interfaces are marked [WebIdlNapiPooled], so blocks freed by the
+    // garbage collector are reused by subsequent instances.
+    for (let round = 0; round < 10; round++) {
+      for (let idx = 1; idx <= 1000; idx++) {
+        const inc = new binding.Incrementor(idx);
+        assert.strictEqual(inc.getDecrementor().decrement(), idx - 1);
+        assert.strictEqual(inc.props, inc.props);
+      }
+      global.gc();
+    }
+  }
+  assert.strictEqual(typeof binding.__webidlNapiStats,
+    (binding === load('class_instrumented') ? 'function' : 'undefined'));
+  testPoolReuse(binding).catch((error) => {
+    console.error(error);
+    process.exitCode = 1;
+  });
   global.gc();
   global.gc();
   global.gc();
@@ -36,3 +221,78 @@ function test(binding) {
   // Give the gc time to act.
   setTimeout(() => {}, 1000);
 }
+
+// The bindings generated with `--instrument-timing` count and time each call.
+function testStats(binding) {
+  const before = binding.__webidlNapiStats();
+  assert.deepStrictEqual(Object.keys(before.Incrementor_increment),
+    ['calls', 'nanoseconds', 'histogram']);
+  const inc = new binding.Incrementor(0);
+  for (let idx = 0; idx < 10; idx++) inc.increment();
+  inc.settableProps = { name: 'counted', count: 1 };
+  inc.getDecrementor();
+  const after = binding.__webidlNapiStats();
+  const calls = (name) => (after[name].calls - before[name].calls);
+  assert.strictEqual(calls('Incrementor_increment'), 10);
+  assert.strictEqual(calls('Incrementor_constructor'), 1);
+  assert.strictEqual(calls('Incrementor_set_settableProps'), 1);
+  assert.strictEqual(calls('Properties_ToNative'), 1);
+  assert.strictEqual(calls('Incrementor_get_props'), 0);
+  assert.strictEqual(calls('Decrementor_ToJS'), 1);
+  const { histogram } = after.Incrementor_increment;
+  assert.strictEqual(histogram.length, 32);
+  assert.strictEqual(histogram.reduce((sum, count) => sum + count),
+    after.Incrementor_increment.calls);
+  assert.ok(after.Incrementor_increment.nanoseconds > 0);
+}
+
+// The blocks of pooled instances are reused once their JS objects have been
+// garbage-collected. Finalizers may run only after the current task, so each
+// round yields to the event loop before the next one allocates.
+async function testPoolReuse(binding) {
+  const rounds = 10;
+  const perRound = 1000;
+  const addresses = new Set();
+  for (let round = 0; round < rounds; round++) {
+    for (let idx = 0; idx < perRound; idx++) {
+      addresses.add(new binding.Incrementor(idx).address());
+    }
+    global.gc();
+    await new Promise((resolve) => setImmediate(resolve));
+  }
+  assert.ok(addresses.size < 2 * perRound,
+    `${addresses.size} blocks for ${rounds * perRound} instances`);
+}
+
+// The bindings generated with `--same-object property` cache the value on the
+// object under a symbol, which is neither enumerable nor writable, and which is
+// unique to the attribute. Objects which cannot hold it fall back to a
+// reference.
+function testSameObjectProperty(binding) {
+  const inc = new binding.Incrementor(1);
+  const props = inc.props;
+  assert.strictEqual(inc.props, props);
+  assert.strictEqual(inc.toJSON().props, props);
+  assert.deepStrictEqual(Object.keys(inc), []);
+  const [ key ] = Object.getOwnPropertySymbols(inc);
+  assert.strictEqual(key.toString(), 'Symbol(Incrementor.props)');
+  assert.deepStrictEqual(Object.getOwnPropertyDescriptor(inc, key), {
+    value: props,
+    writable: false,
+    enumerable: false,
+    configurable: false
+  });
+  assert.notStrictEqual(Object.getOwnPropertySymbols(new binding.Incrementor()),
+    key);
+
+  for (const seal of [ Object.freeze, Object.seal, Object.preventExtensions ]) {
+    const sealed = seal(new binding.Incrementor(2));
+    const sealedProps = sealed.props;
+    assert.strictEqual(sealed.props, sealedProps);
+    assert.strictEqual(sealed.toJSON().props, sealedProps);
+    assert.deepStrictEqual(Object.getOwnPropertySymbols(sealed), []);
+
+    const snapshotFirst = seal(new binding.Incrementor(3));
+    assert.strictEqual(snapshotFirst.toJSON().props, snapshotFirst.props);
+  }
+}
@@ -0,0 +1,5 @@
+#include <node_api.h>
+
+napi_value iterable_init(napi_env env);
+
+NAPI_MODULE_INIT() { return iterable_init(env); }
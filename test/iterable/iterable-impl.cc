@@ -0,0 +1,32 @@
+#include <string>
+#include "iterable-impl.h"
+
+// Keys are zero-padded so that they sort like their values.
+Registry::Registry(unsigned long count) {
+  for (unsigned long idx = 0; idx < count; idx++) {
+    std::string key = std::to_string(idx);
+    (*this)["key " + std::string(7 - key.size(), '0') + key] = idx;
+  }
+}
+
+// Both return how many items they added or removed.
+unsigned long Registry::put(const DOMString& key, unsigned long value) {
+  return emplace(key, value).second ? 1 : 0;
+}
+
+unsigned long Registry::remove(const DOMString& key) {
+  return erase(key);
+}
+
+Tags::Tags(): std::set<DOMString>({ "alpha", "beta", "gamma" }) {}
+
+Samples::Samples(unsigned long count) {
+  resample(count);
+}
+
+unsigned long Samples::resample(unsigned long count) {
+  unsigned long previous = size();
+  if (count < previous) resize(count);
+  for (unsigned long idx = previous; idx < count; idx++) push_back(idx * 0.5);
+  return previous;
+}
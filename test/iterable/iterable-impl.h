@@ -0,0 +1,29 @@
+#ifndef WEBIDL_NAPI_TEST_ITERABLE_ITERABLE_IMPL_H
+#define WEBIDL_NAPI_TEST_ITERABLE_ITERABLE_IMPL_H
+
+#include <map>
+#include <set>
+#include <vector>
+#include "webidl-napi.h"
+
+using namespace WebIdlNapi;
+
+// Each instance is the container over which its JS object iterates.
+struct Registry : public std::map<DOMString, unsigned long> {
+  explicit Registry(unsigned long count = 0);
+  unsigned long put(const DOMString& key, unsigned long value);
+  unsigned long remove(const DOMString& key);
+};
+
+struct Tags : public std::set<DOMString> {
+  Tags();
+};
+
+struct Samples : public std::vector<double> {
+  explicit Samples(unsigned long count = 0);
+  // Keeps or adds samples so that there are `count`, and returns how many
+  // there were.
+  unsigned long resample(unsigned long count);
+};
+
+#endif  // WEBIDL_NAPI_TEST_ITERABLE_ITERABLE_IMPL_H
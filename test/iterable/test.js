@@ -0,0 +1,163 @@
+'use strict';
+const assert = require('assert');
+const binding =
+  require('bindings')({ bindings: 'iterable', module_root: __dirname });
+
+// A maplike interface has the methods of a read-only `Map`.
+const registry = new binding.Registry(3);
+assert.strictEqual(registry.size, 3);
+assert.deepStrictEqual([...registry], [
+  [ 'key 0000000', 0 ], [ 'key 0000001', 1 ], [ 'key 0000002', 2 ]
+]);
+assert.deepStrictEqual([...registry.keys()],
+  [ 'key 0000000', 'key 0000001', 'key 0000002' ]);
+assert.deepStrictEqual([...registry.values()], [ 0, 1, 2 ]);
+assert.deepStrictEqual([...registry.entries()], [...registry]);
+assert.strictEqual(registry.get('key 0000001'), 1);
+assert.strictEqual(registry.get('key 3'), undefined);
+assert.strictEqual(registry.has('key 0000002'), true);
+assert.strictEqual(registry.has('key 3'), false);
+assert.strictEqual(registry.set, undefined);
+const visited = [];
+const thisArg = {};
+registry.forEach(function(value, key, map) {
+  assert.strictEqual(this, thisArg);
+  assert.strictEqual(map, registry);
+  visited.push([ key, value ]);
+}, thisArg);
+assert.deepStrictEqual(visited, [...registry]);
+assert.throws(() => registry.forEach({}), { code: 'napi_function_expected' });
+
+// A setlike interface has the methods of a read-only `Set`.
+const tags = new binding.Tags();
+assert.strictEqual(tags.size, 3);
+assert.deepStrictEqual([...tags], [ 'alpha', 'beta', 'gamma' ]);
+assert.deepStrictEqual([...tags.keys()], [...tags]);
+assert.deepStrictEqual([...tags.entries()],
+  [ [ 'alpha', 'alpha' ], [ 'beta', 'beta' ], [ 'gamma', 'gamma' ] ]);
+assert.strictEqual(tags.has('beta'), true);
+assert.strictEqual(tags.has('delta'), false);
+assert.strictEqual(tags.add, undefined);
+
+// A value iterable is keyed by index.
+const samples = new binding.Samples(4);
+assert.deepStrictEqual([...samples], [ 0, 0.5, 1, 1.5 ]);
+assert.deepStrictEqual([...samples.keys()], [ 0, 1, 2, 3 ]);
+assert.deepStrictEqual([...samples.entries()].slice(-1), [ [ 3, 1.5 ] ]);
+assert.strictEqual(samples.size, undefined);
+
+// Iterators step through the container lazily, and `nextBatch(n)` returns up
+// to `n` results at once, and an empty array at the end.
+const iterator = samples.values();
+assert.strictEqual(iterator[Symbol.iterator](), iterator);
+assert.deepStrictEqual(iterator.next(), { value: 0, done: false });
+assert.deepStrictEqual(iterator.nextBatch(2), [ 0.5, 1 ]);
+assert.deepStrictEqual(iterator.nextBatch(2), [ 1.5 ]);
+assert.deepStrictEqual(iterator.nextBatch(2), []);
+assert.deepStrictEqual(iterator.next(), { value: undefined, done: true });
+
+// Iterators inherit from %IteratorPrototype%, and `next()` fetches results in
+// batches, from which `nextBatch(n)` returns first.
+const IteratorPrototype =
+  Object.getPrototypeOf(Object.getPrototypeOf([][Symbol.iterator]()));
+assert.strictEqual(Object.getPrototypeOf(Object.getPrototypeOf(iterator)),
+  IteratorPrototype);
+assert.strictEqual(Object.keys(Object.getPrototypeOf(iterator)).length, 0);
+const mixed = new binding.Samples(8).values();
+assert.deepStrictEqual(mixed.next(), { value: 0, done: false });
+assert.deepStrictEqual(mixed.next(), { value: 0.5, done: false });
+assert.deepStrictEqual(mixed.nextBatch(3), [ 1 ]);
+assert.deepStrictEqual(mixed.nextBatch(3), [ 1.5, 2, 2.5 ]);
+assert.deepStrictEqual([...mixed], [ 3, 3.5 ]);
+assert.deepStrictEqual(mixed.next(), { value: undefined, done: true });
+assert.deepStrictEqual(mixed.nextBatch(1), []);
+
+// The container may be modified while JS iterates over it. Each batch resumes
+// after the results which came before it, within the container as it is
+// then. Once an iterator has reached the end, it stays there.
+const resampled = new binding.Samples(4);
+const shrunk = resampled.values();
+assert.deepStrictEqual(shrunk.nextBatch(3), [ 0, 0.5, 1 ]);
+assert.strictEqual(resampled.resample(2), 4);
+assert.deepStrictEqual(shrunk.nextBatch(3), []);
+const grown = resampled.entries();
+assert.deepStrictEqual(grown.nextBatch(1), [ [ 0, 0 ] ]);
+resampled.resample(1000);
+assert.deepStrictEqual(grown.nextBatch(2), [ [ 1, 0.5 ], [ 2, 1 ] ]);
+resampled.resample(4);
+assert.deepStrictEqual(grown.nextBatch(2), [ [ 3, 1.5 ] ]);
+resampled.resample(8);
+assert.deepStrictEqual(grown.nextBatch(2), []);
+
+const edited = new binding.Registry(4);
+const editedKeys = edited.keys();
+assert.deepStrictEqual(editedKeys.nextBatch(2), [ 'key 0000000', 'key 0000001' ]);
+assert.strictEqual(edited.remove('key 0000001'), 1);
+assert.strictEqual(edited.put('key 0000004', 4), 1);
+assert.deepStrictEqual(editedKeys.nextBatch(4),
+  [ 'key 0000002', 'key 0000003', 'key 0000004' ]);
+const editedValues = edited.values();
+assert.deepStrictEqual(editedValues.nextBatch(1), [ 0 ]);
+assert.strictEqual(edited.remove('key 0000002'), 1);
+assert.deepStrictEqual(editedValues.nextBatch(1), [ 3 ]);
+for (const key of [...edited.keys()]) edited.remove(key);
+assert.deepStrictEqual(editedValues.nextBatch(1), []);
+
+const pruned = new binding.Registry(4);
+const prunedKeys = [];
+for (const key of pruned.keys()) {
+  prunedKeys.push(key);
+  pruned.remove(key);
+}
+assert.deepStrictEqual(prunedKeys,
+  [ 'key 0000000', 'key 0000001', 'key 0000002', 'key 0000003' ]);
+assert.strictEqual(pruned.size, 0);
+
+// `forEach()` looks up each item after calling the callback for the previous
+// one.
+const visitedKeys = [];
+const visitedMap = new binding.Registry(4);
+visitedMap.forEach((value, key) => {
+  visitedKeys.push(key);
+  visitedMap.remove('key 0000002');
+  if (value === 3) visitedMap.put('key 0000005', 5);
+});
+assert.deepStrictEqual(visitedKeys,
+  [ 'key 0000000', 'key 0000001', 'key 0000003', 'key 0000005' ]);
+const visitedValues = [];
+const visitedSamples = new binding.Samples(1);
+visitedSamples.forEach((value) => {
+  visitedValues.push(value);
+  if (value === 0) visitedSamples.resample(3);
+});
+assert.deepStrictEqual(visitedValues, [ 0, 0.5, 1 ]);
+
+const count = 1000000;
+const large = new binding.Registry(count);
+const entries = large.entries();
+let seen = 0;
+for (let batch = entries.nextBatch(4096); batch.length > 0;
+  batch = entries.nextBatch(4096)) {
+  assert.strictEqual(batch[0][1], seen);
+  seen += batch.length;
+}
+assert.strictEqual(seen, count);
+seen = 0;
+for (const [ key, value ] of large) {
+  assert.strictEqual(value, seen++);
+  assert.strictEqual(typeof key, 'string');
+}
+assert.strictEqual(seen, count);
+
+// The methods reject receivers of other classes, and iterators which JS has
+// constructed itself.
+assert.throws(() => iterator.next.call(registry), TypeError);
+assert.throws(() => new iterator.constructor().next(), {
+  code: 'napi_invalid_arg'
+});
+assert.throws(() => binding.Registry.prototype.keys.call(samples));
+
+// An iterator keeps the object over whose container it iterates alive.
+const orphan = new binding.Samples(2).values();
+global.gc();
+assert.deepStrictEqual(orphan.nextBatch(3), [ 0, 0.5 ]);
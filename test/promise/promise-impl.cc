@@ -1,10 +1,66 @@
 #include <stdio.h>
+#include <chrono>
+#include <thread>
 #include "promise-impl.h"
 
-Promise<FulfillsPromise>
+Promise<Nullable<FulfillsPromise>>
 ReturnsPromise::requestPromise(DOMString name) {
   FulfillsPromise result{name};
-  Promise<FulfillsPromise> promise;
-  promise.Resolve(result);
+  Promise<Nullable<FulfillsPromise>> promise;
+  promise.Resolve(std::move(result));
   return promise;
 }
+
+// The thread keeps a copy of the promise, which shares its state with the
+// copy returned to JS.
+Promise<Nullable<FulfillsPromise>>
+ReturnsPromise::requestPromiseFromThread(DOMString name) {
+  Promise<Nullable<FulfillsPromise>> promise;
+  std::thread([promise, name]() mutable {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    promise.Resolve(FulfillsPromise{name});
+  }).detach();
+  return promise;
+}
+
+Promise<Nullable<FulfillsPromise>>
+ReturnsPromise::rejectFromThread() {
+  Promise<Nullable<FulfillsPromise>> promise;
+  std::thread([promise]() mutable {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    promise.Reject();
+  }).detach();
+  return promise;
+}
+
+Promise<Nullable<FulfillsPromise>>
+ReturnsPromise::rejectWithCodeFromThread() {
+  Promise<Nullable<FulfillsPromise>> promise;
+  std::thread([promise]() mutable {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    promise.Reject("ERR_OVERLOADED",
+                   "Too many requests",
+                   ErrorType::kRangeError);
+  }).detach();
+  return promise;
+}
+
+Promise<Nullable<FulfillsPromise>> ReturnsPromise::abandon() {
+  return Promise<Nullable<FulfillsPromise>>();
+}
+
+// The thread drops the last copy of the promise.
+Promise<Nullable<FulfillsPromise>> ReturnsPromise::abandonFromThread() {
+  Promise<Nullable<FulfillsPromise>> promise;
+  std::thread([promise]() mutable {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    promise = Promise<Nullable<FulfillsPromise>>();
+  }).detach();
+  return promise;
+}
+
+// Returns an empty name if the call unexpectedly runs on the JS thread.
+Nullable<FulfillsPromise> ReturnsPromise::computeAsync(DOMString name) {
+  bool off_thread = (std::this_thread::get_id() != js_thread);
+  return FulfillsPromise{off_thread ? name : DOMString()};
+}
@@ -1,6 +1,7 @@
 #ifndef WEBIDL_NAPI_TEST_WEBIDL2_EXAMPLE_EXAMPLE_IMPL_H
 #define WEBIDL_NAPI_TEST_WEBIDL2_EXAMPLE_EXAMPLE_IMPL_H
 
+#include <thread>
 #include "webidl-napi.h"
 
 using namespace WebIdlNapi;
@@ -10,7 +11,16 @@ struct FulfillsPromise {
 };
 
 struct ReturnsPromise {
-  Promise<FulfillsPromise> requestPromise(DOMString name);
+  Promise<Nullable<FulfillsPromise>> requestPromise(DOMString name);
+  Promise<Nullable<FulfillsPromise>> requestPromiseFromThread(DOMString name);
+  Promise<Nullable<FulfillsPromise>> rejectFromThread();
+  Promise<Nullable<FulfillsPromise>> rejectWithCodeFromThread();
+  // Never settle the promises they return.
+  Promise<Nullable<FulfillsPromise>> abandon();
+  Promise<Nullable<FulfillsPromise>> abandonFromThread();
+  // Marked [WebIdlNapiAsync], so this runs on the libuv threadpool.
+  Nullable<FulfillsPromise> computeAsync(DOMString name);
+  std::thread::id js_thread = std::this_thread::get_id();
 };
 
 #endif  // WEBIDL_NAPI_TEST_WEBIDL2_EXAMPLE_EXAMPLE_IMPL_H
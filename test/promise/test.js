@@ -1,10 +1,95 @@
 'use strict';
 const buildType = process.config.target_defaults.default_configuration;
 const assert = require('assert');
-test(require('bindings')({ bindings: 'promise', module_root: __dirname }));
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const { spawnSync } = require('child_process');
+test(require('bindings')({ bindings: 'promise', module_root: __dirname }))
+  .catch((error) => {
+    console.error(error);
+    process.exitCode = 1;
+  });
 
 async function test(binding) {
   const retPro = new binding.ReturnsPromise();
   const result = await retPro.requestPromise("something");
   assert.deepStrictEqual(result, { name: "something" });
+
+  // Promises resolved on other threads are settled on the JS thread, and the
+  // pending promises keep the process alive until then.
+  const names = Array.from({ length: 100 }, (_, idx) => `name ${idx}`);
+  const results = await Promise.all(
+    names.map((name) => retPro.requestPromiseFromThread(name)));
+  assert.deepStrictEqual(results, names.map((name) => ({ name })));
+
+  await assert.rejects(retPro.rejectFromThread(), /Promise rejected/);
+
+  // Rejections may carry a code and an error type. Node.js 10 also appends the
+  // code to the name of the error.
+  for (let idx = 0; idx < 2; idx++) {
+    await assert.rejects(retPro.rejectWithCodeFromThread(), (error) => {
+      assert.ok(error instanceof RangeError);
+      assert.strictEqual(error.code, 'ERR_OVERLOADED');
+      assert.strictEqual(error.message, 'Too many requests');
+      return true;
+    });
+  }
+
+  // Operations marked [WebIdlNapiAsync] run on the threadpool.
+  const computed = await Promise.all(
+    names.map((name) => retPro.computeAsync(name)));
+  assert.deepStrictEqual(computed, names.map((name) => ({ name })));
+
+  testAbandoned();
+  testAsyncRejectsJSValues();
+}
+
+// Promises which are dropped without being settled do not keep the process
+// alive.
+function testAbandoned() {
+  const child = spawnSync(process.execPath, [ '-e', `
+    const binding = require(${JSON.stringify(require.resolve('bindings'))})({
+      bindings: 'promise',
+      module_root: ${JSON.stringify(__dirname)}
+    });
+    const retPro = new binding.ReturnsPromise();
+    retPro.abandon();
+    retPro.abandonFromThread();
+  ` ], { encoding: 'utf-8', timeout: 10000 });
+  assert.strictEqual(child.signal, null, 'The process did not exit');
+  assert.strictEqual(child.status, 0, child.stderr);
+}
+
+// JS values must not cross to the threadpool, so the generator rejects
+// asynchronous operations taking or returning them, directly or in
+// dictionaries.
+function testAsyncRejectsJSValues() {
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'webidl-napi-'));
+  const generate = (source) => {
+    const idl = path.join(dir, 'async.idl');
+    fs.writeFileSync(idl, source);
+    return spawnSync(process.execPath, [
+      path.join(__dirname, '..', '..', 'index.js'),
+      '-o', path.join(dir, 'async.cc'),
+      idl
+    ], { encoding: 'utf-8' });
+  };
+  const iface = (op) => `dictionary Holder { object held; };\n` +
+    `interface Worker { [WebIdlNapiAsync] ${op}; };\n`;
+  for (const op of [
+    'Promise<object> run()',
+    'Promise<Holder> run()',
+    'Promise<long> run(any value)',
+    'Promise<long> run(sequence<Holder> values)',
+  ]) {
+    const child = generate(iface(op));
+    assert.notStrictEqual(child.status, 0, op);
+    assert.ok(/does not support arguments or results holding JS values/
+      .test(child.stderr), child.stderr);
+  }
+  assert.strictEqual(generate(iface('Promise<long> run(long value)')).status,
+    0);
+  fs.readdirSync(dir).forEach((item) => fs.unlinkSync(path.join(dir, item)));
+  fs.rmdirSync(dir);
 }
@@ -0,0 +1,67 @@
+'use strict';
+const assert = require('assert');
+const { spawnSync } = require('child_process');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+// `--split` writes a file per definition of the IDL of the webgpu test, and
+// leaves the files whose contents are unchanged untouched. It records the
+// files in a manifest, and deletes those it no longer generates.
+const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'webidl-napi-'));
+const idl = path.join(dir, 'webgpu.idl');
+const output = path.join(dir, 'webgpu.cc');
+const generate = (...extra) => {
+  const child = spawnSync(process.execPath, [
+    path.join(__dirname, '..', '..', 'index.js'),
+    ...extra,
+    '-i', 'webgpu-impl.h',
+    '-o', output,
+    idl
+  ], { encoding: 'utf-8' });
+  assert.strictEqual(child.status, 0, child.stderr);
+  return child.stdout;
+};
+const listing = () => fs.readdirSync(dir).sort();
+const source = fs.readFileSync(
+  path.join(__dirname, '..', 'webgpu', 'webgpu.idl'), 'utf-8');
+fs.writeFileSync(idl, source);
+const outputs = generate('--split', '--list-outputs').trim().split(';');
+assert.ok(outputs.includes(path.join(dir, 'webgpu.h')));
+assert.ok(outputs.includes(path.join(dir, 'webgpu-GPUDevice.cc')));
+assert.ok(outputs.includes(path.join(dir, 'webgpu-GPULimits.cc')));
+assert.ok(outputs.includes(path.join(dir, 'webgpu.outputs')));
+assert.ok(!fs.existsSync(output));
+
+generate('--split');
+const names = [ 'webgpu.idl', ...outputs.map((item) => path.basename(item)) ];
+assert.deepStrictEqual(listing(), names.sort());
+assert.deepStrictEqual(
+  fs.readFileSync(path.join(dir, 'webgpu.outputs'), 'utf-8').split('\n'),
+  [ ...outputs.map((item) => path.basename(item)).slice(0, -1), '' ]);
+
+outputs.forEach((item) => fs.utimesSync(item, 0, 0));
+fs.writeFileSync(idl, source.replace('interface GPUDevice {',
+  'interface GPUDevice {\n  readonly attribute unsigned long extra;'));
+generate('--split');
+assert.deepStrictEqual(
+  outputs.filter((item) => (fs.statSync(item).mtimeMs !== 0)),
+  [ path.join(dir, 'webgpu-GPUDevice.cc') ]);
+
+// The file of a definition is deleted once the definition is removed.
+fs.writeFileSync(idl, source + '\ninterface Extra {\n};\n');
+generate('--split');
+assert.ok(fs.existsSync(path.join(dir, 'webgpu-Extra.cc')));
+fs.writeFileSync(idl, source);
+generate('--split');
+assert.deepStrictEqual(listing(), names.sort());
+
+// Files it did not generate are left alone, and generating a single file
+// deletes all those generated with `--split`.
+fs.writeFileSync(path.join(dir, 'webgpu-Other.cc'), '');
+generate();
+assert.deepStrictEqual(listing(),
+  [ 'webgpu-Other.cc', 'webgpu.cc', 'webgpu.idl' ]);
+
+listing().forEach((item) => fs.unlinkSync(path.join(dir, item)));
+fs.rmdirSync(dir);
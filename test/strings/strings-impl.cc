@@ -0,0 +1,38 @@
+#include "strings-impl.h"
+
+DOMString Strings::echo(DOMString value) { return value; }
+
+unsigned long Strings::length(DOMString value) { return value.size(); }
+
+ByteString Strings::echoBytes(ByteString value) { return value; }
+
+unsigned long Strings::byteLength(ByteString value) { return value.size(); }
+
+WebIdlNapi::Nullable<DOMString>
+Strings::echoNullable(WebIdlNapi::Nullable<DOMString> value) {
+  return value;
+}
+
+DOMString Strings::repeat(DOMString value,
+                          WebIdlNapi::Optional<unsigned long> count) {
+  DOMString result;
+  for (unsigned long idx = 0; idx < (count ? *count : 2); idx++)
+    result += value;
+  return result;
+}
+
+DOMString Strings::describe(DOMString value,
+                            WebIdlNapi::Nullable<DOMString> label) {
+  if (!label) return value;
+  const char separator[] = ": ";
+  return *label + DOMString(separator, separator + 2) + value;
+}
+
+DOMString Strings::describe(unsigned long width,
+                            WebIdlNapi::Nullable<DOMString> label) {
+  return describe(DOMString(width, '#'), std::move(label));
+}
+
+DOMString Strings::echoDefault(DOMString value) { return value; }
+
+ByteString Strings::echoBytesDefault(ByteString value) { return value; }
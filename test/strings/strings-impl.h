@@ -0,0 +1,29 @@
+#ifndef WEBIDL_NAPI_TEST_STRINGS_STRINGS_IMPL_H
+#define WEBIDL_NAPI_TEST_STRINGS_STRINGS_IMPL_H
+
+#include "webidl-napi.h"
+
+class Strings {
+ public:
+  static DOMString echo(DOMString value);
+  // The number of code units, which are UTF-8 bytes by default, and UTF-16
+  // code units if WEBIDL_NAPI_UTF16_DOMSTRING is defined.
+  static unsigned long length(DOMString value);
+  static ByteString echoBytes(ByteString value);
+  static unsigned long byteLength(ByteString value);
+  static WebIdlNapi::Nullable<DOMString>
+  echoNullable(WebIdlNapi::Nullable<DOMString> value);
+  // Repeats `value` twice if `count` is missing.
+  static DOMString repeat(DOMString value,
+                          WebIdlNapi::Optional<unsigned long> count);
+  // Prefixes the value, or a bar `width` characters wide, with the label.
+  static DOMString describe(DOMString value,
+                            WebIdlNapi::Nullable<DOMString> label);
+  static DOMString describe(unsigned long width,
+                            WebIdlNapi::Nullable<DOMString> label);
+  // Return the value, which defaults to a string that is not ASCII.
+  static DOMString echoDefault(DOMString value);
+  static ByteString echoBytesDefault(ByteString value);
+};
+
+#endif  // WEBIDL_NAPI_TEST_STRINGS_STRINGS_IMPL_H
@@ -0,0 +1,56 @@
+'use strict';
+const assert = require('assert');
+test(require('bindings')({ bindings: 'strings', module_root: __dirname }),
+  (str) => Buffer.byteLength(str));
+test(require('bindings')({ bindings: 'strings_utf16', module_root: __dirname }),
+  (str) => str.length);
+
+function test(binding, expectedLength) {
+  const { Strings } = binding;
+
+  // Strings on either side of the size of the stack buffer used for the
+  // conversion, including ones where a multi-byte character straddles it.
+  const strings = [ '', 'abc', 'a\0b', 'x'.repeat(10000) ];
+  for (let length = 240; length < 270; length++) {
+    strings.push('x'.repeat(length));
+    strings.push('x'.repeat(length - 2) + 'é');
+    strings.push('x'.repeat(length - 3) + '€');
+    strings.push('x'.repeat(length - 4) + '\u{1f600}');
+  }
+  for (const str of strings) {
+    assert.strictEqual(Strings.echo(str), str);
+    assert.strictEqual(Strings.length(str), expectedLength(str));
+  }
+
+  // ByteStrings hold one byte per character.
+  const bytes = [ '', 'abc', 'ÿé', 'é'.repeat(300) ];
+  for (const str of bytes) {
+    assert.strictEqual(Strings.echoBytes(str), str);
+    assert.strictEqual(Strings.byteLength(str), str.length);
+  }
+
+  // Nullable values convert from `null` and `undefined`, and to `null`.
+  assert.strictEqual(Strings.echoNullable('abc'), 'abc');
+  assert.strictEqual(Strings.echoNullable(null), null);
+  assert.strictEqual(Strings.echoNullable(undefined), null);
+  assert.strictEqual(Strings.echoNullable(), null);
+
+  // Optional arguments are empty when missing or `undefined`.
+  assert.strictEqual(Strings.repeat('ab'), 'abab');
+  assert.strictEqual(Strings.repeat('ab', undefined), 'abab');
+  assert.strictEqual(Strings.repeat('ab', 3), 'ababab');
+  assert.strictEqual(Strings.repeat('ab', 0), '');
+
+  // Overloads with nullable optional arguments.
+  assert.strictEqual(Strings.describe('abc'), 'abc');
+  assert.strictEqual(Strings.describe('abc', null), 'abc');
+  assert.strictEqual(Strings.describe('abc', 'label'), 'label: abc');
+  assert.strictEqual(Strings.describe(3), '###');
+  assert.strictEqual(Strings.describe(3, undefined), '###');
+  assert.strictEqual(Strings.describe(3, 'bar'), 'bar: ###');
+
+  // Default values which are not ASCII are converted exactly.
+  assert.strictEqual(Strings.echoDefault(), 'é € \u{1f600} \\ ??= 0');
+  assert.strictEqual(Strings.echoDefault('abc'), 'abc');
+  assert.strictEqual(Strings.echoBytesDefault(), 'ÿé \\ 0');
+}
@@ -1,9 +1,40 @@
 'use strict';
 const assert = require('assert');
-test(require('bindings')({ bindings: 'webgpu', module_root: __dirname }));
+test(require('bindings')({ bindings: 'webgpu', module_root: __dirname }))
+  .catch((error) => {
+    console.error(error);
+    process.exitCode = 1;
+  });
 
 async function test(binding) {
+  // The bindings are generated with `--lazy-interfaces`, so each class is
+  // defined upon first access, after which it is a plain value. Node.js 10
+  // cannot replace an accessor while it runs, so there the classes are defined
+  // up front instead.
+  const isLazy = (Number(process.versions.node.split('.')[0]) >= 12);
+  const descriptor = (name) => Object.getOwnPropertyDescriptor(binding, name);
+  assert.strictEqual(typeof descriptor('GPU').get,
+    (isLazy ? 'function' : 'undefined'));
   const gpu = new binding.GPU();
+  assert.strictEqual(binding.GPU, binding.GPU);
+  assert.strictEqual(descriptor('GPU').value, binding.GPU);
+  assert.strictEqual(descriptor('GPU').get, undefined);
+  assert.deepStrictEqual(Object.keys(binding).sort(),
+    ['GPU', 'GPUAdapter', 'GPUDevice', 'Navigator', 'WorkerNavigator']);
+
+  // Returning an instance to JS defines its class as well, while the class
+  // remains to be accessed, and accessing it afterwards yields the same
+  // constructor.
+  assert.strictEqual(typeof descriptor('GPUAdapter').get,
+    (isLazy ? 'function' : 'undefined'));
+  const firstAdapter = await gpu.requestAdapter();
+  const adapterClass = Object.getPrototypeOf(firstAdapter).constructor;
+  assert.strictEqual(adapterClass.name, 'GPUAdapter');
+  assert.strictEqual(typeof descriptor('GPUAdapter').get,
+    (isLazy ? 'function' : 'undefined'));
+  assert.strictEqual(binding.GPUAdapter, adapterClass);
+  assert.strictEqual(descriptor('GPUAdapter').value, adapterClass);
+
   async function testAdapter(options) {
     const adapter =
       await gpu.requestAdapter(options);
@@ -12,10 +43,33 @@ async function test(binding) {
     assert.deepStrictEqual(adapter.extensions, [
       'depth-clamping', 'timestamp-query'
     ]);
+
+    // Enum values are returned from strings cached per env.
+    global.gc();
+    for (let idx = 0; idx < 10; idx++) {
+      assert.deepStrictEqual(adapter.extensions, [
+        'depth-clamping', 'timestamp-query'
+      ]);
+    }
   }
 
-  // TODO (gabrielschulhof): Expect a more specific error.
-  assert.throws(() => gpu.requestAdapter({powerPreference: 'low-powder'}));
+  // Errors carry the name of the failing status as their code.
+  assert.throws(() => gpu.requestAdapter({powerPreference: 'low-powder'}), {
+    code: 'napi_invalid_arg',
+    message: /^Invalid argument\n    at webidl_napi_interface_GPU_requestAdapter /
+  });
+
+  // Neither a prefix of an enum value nor a string that extends one matches.
+  assert.throws(() => gpu.requestAdapter({powerPreference: 'low'}));
+  assert.throws(() => gpu.requestAdapter({powerPreference: ''}));
+  assert.throws(() => gpu.requestAdapter({powerPreference: 'low-powers'}));
+
+  // N-API truncates strings on character boundaries, so an enum value followed
+  // by a single multi-byte character must not match either.
+  for (const suffix of [ '\u00e9', '\u20ac', '\ud83d\ude00' ]) {
+    assert.throws(() =>
+      gpu.requestAdapter({powerPreference: 'high-performance' + suffix}));
+  }
 
   await testAdapter({ powerPreference: 'high-performance' });
   await testAdapter();
@@ -25,4 +79,7 @@ async function test(binding) {
   const gpu1 = nav.gpu;
   const gpu2 = nav.gpu;
   assert.strictEqual(gpu1, gpu2);
+  assert.notStrictEqual(new binding.Navigator().gpu, gpu1);
+  const workerNav = new binding.WorkerNavigator();
+  assert.strictEqual(workerNav.gpu, workerNav.gpu);
 }
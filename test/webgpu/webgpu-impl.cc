@@ -8,8 +8,8 @@ GPUAdapter::GPUAdapter():
       GPUExtensionName::Timestamp_query
     }) {}
 
-WebIdlNapi::Promise<GPUAdapter> GPU::requestAdapter(
-                                      const GPURequestAdapterOptions& options) {
+WebIdlNapi::Promise<WebIdlNapi::Nullable<GPUAdapter>>
+GPU::requestAdapter(const GPURequestAdapterOptions& options) {
   fprintf(stderr,
       "GPU::requestAdapter with options { powerPreference: %d(%s) }\n",
       static_cast<int>(options.powerPreference),
@@ -19,14 +19,14 @@ WebIdlNapi::Promise<GPUAdapter> GPU::requestAdapter(
           ? "High_performance"
           : "unknown");
 
-  WebIdlNapi::Promise<GPUAdapter> result;
-  result.Resolve({});
+  WebIdlNapi::Promise<WebIdlNapi::Nullable<GPUAdapter>> result;
+  result.Resolve(GPUAdapter());
   return result;
 }
 
-WebIdlNapi::Promise<GPUDevice> GPUAdapter::requestDevice(
-                                        const GPUDeviceDescriptor& descriptor) {
-  WebIdlNapi::Promise<GPUDevice> result;
-  result.Resolve({});
+WebIdlNapi::Promise<WebIdlNapi::Nullable<GPUDevice>>
+GPUAdapter::requestDevice(const GPUDeviceDescriptor& descriptor) {
+  WebIdlNapi::Promise<WebIdlNapi::Nullable<GPUDevice>> result;
+  result.Resolve(GPUDevice());
   return result;
 }
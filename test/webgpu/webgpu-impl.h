@@ -52,12 +52,12 @@ struct GPUAdapter {
   GPUAdapter();
   DOMString name;
   WebIdlNapi::FrozenArray<GPUExtensionName> extensions;
-  static WebIdlNapi::Promise<GPUDevice> requestDevice(const GPUDeviceDescriptor& descriptor);
+  static WebIdlNapi::Promise<WebIdlNapi::Nullable<GPUDevice>> requestDevice(const GPUDeviceDescriptor& descriptor);
 };
 
 class GPU {
  public:
-  static WebIdlNapi::Promise<GPUAdapter> requestAdapter(const GPURequestAdapterOptions& options);
+  static WebIdlNapi::Promise<WebIdlNapi::Nullable<GPUAdapter>> requestAdapter(const GPURequestAdapterOptions& options);
 };
 
 struct Navigator {
@@ -7,11 +7,108 @@ namespace WebIdlNapi {
 
 namespace details {
 
+// The name and the message of each `napi_status`, indexed by its value. Both
+// are taken from Node.js.
+static const char* const kStatusNames[][2] = {
+  { "napi_ok", "" },
+  { "napi_invalid_arg", "Invalid argument" },
+  { "napi_object_expected", "An object was expected" },
+  { "napi_string_expected", "A string was expected" },
+  { "napi_name_expected", "A string or symbol was expected" },
+  { "napi_function_expected", "A function was expected" },
+  { "napi_number_expected", "A number was expected" },
+  { "napi_boolean_expected", "A boolean was expected" },
+  { "napi_array_expected", "An array was expected" },
+  { "napi_generic_failure", "Unknown failure" },
+  { "napi_pending_exception", "An exception is pending" },
+  { "napi_cancelled", "The async work item was cancelled" },
+  { "napi_escape_called_twice", "napi_escape_handle already called on scope" },
+  { "napi_handle_scope_mismatch", "Invalid handle scope usage" },
+  { "napi_callback_scope_mismatch", "Invalid callback scope usage" },
+  { "napi_queue_full", "Thread-safe function queue is full" },
+  { "napi_closing", "Thread-safe function handle is closing" },
+  { "napi_bigint_expected", "A bigint was expected" },
+  { "napi_date_expected", "A date was expected" },
+  { "napi_arraybuffer_expected", "An arraybuffer was expected" },
+  { "napi_detachable_arraybuffer_expected",
+    "A detachable arraybuffer was expected" },
+  { "napi_would_deadlock", "Main thread would deadlock" }
+};
+
+}  // end of namespace details
+
+template <typename Unused>
+void ThrowError(napi_env env,
+                napi_status status,
+                const char* function,
+                const char* location) {
+  bool is_pending;
+  if (napi_is_exception_pending(env, &is_pending) != napi_ok || is_pending)
+    return;
+
+  const size_t status_count =
+      sizeof(details::kStatusNames) / sizeof(*details::kStatusNames);
+  const char* code = nullptr;
+  const char* message = "Unknown failure";
+  if (status > napi_ok && static_cast<size_t>(status) < status_count) {
+    code = details::kStatusNames[status][0];
+    message = details::kStatusNames[status][1];
+  }
+
+  // The message is formatted on the stack, which truncates long locations.
+  char buffer[512];
+  if (function != nullptr && location != nullptr) {
+    snprintf(buffer,
+             sizeof(buffer),
+             "%s\n    at %s (%s)",
+             message,
+             function,
+             location);
+    message = buffer;
+  }
+  napi_throw_error(env, code, message);
+}
+
+template <typename Unused>
+void ThrowLastError(napi_env env,
+                    const char* function,
+                    const char* location) {
+  const napi_extended_error_info* error_info;
+  if (napi_get_last_error_info(env, &error_info) != napi_ok) return;
+  ThrowError(env, error_info->error_code, function, location);
+}
+
+template <typename T>
+inline napi_status ElementConverter<T>::Init(napi_env) {
+  return napi_ok;
+}
+
+template <typename T>
+inline napi_status
+ElementConverter<T>::ToNative(napi_env env, napi_value value, T* result) {
+  return Converter<T>::ToNative(env, value, result);
+}
+
+template <typename T>
+inline napi_status
+ElementConverter<T>::ToJS(napi_env env, const T& value, napi_value* result) {
+  return Converter<T>::ToJS(env, value, result);
+}
+
+namespace details {
+
+// Handles created while converting the elements of an array are released in
+// chunks of this many elements, so that the number of live handles does not
+// grow with the length of the array.
+static const uint32_t kHandleScopeChunkSize = 256;
+
 template <typename ArrayType, typename T, bool freeze>
 static inline napi_status
 ArrayToJS(napi_env env, const ArrayType& ar, napi_value* result) {
   napi_status status;
   napi_escapable_handle_scope scope;
+  napi_handle_scope chunk_scope = nullptr;
+  ElementConverter<T> converter;
   napi_value res;
 
   // TODO(gabrielschulhof): Once `napi_freeze_object` becomes available in all
@@ -22,69 +119,262 @@ ArrayToJS(napi_env env, const ArrayType& ar, napi_value* result) {
   status = napi_open_escapable_handle_scope(env, &scope);
   if (status != napi_ok) return status;
 
-  status = napi_create_array(env, &res);
+  status = napi_create_array_with_length(env, ar.size(), &res);
+  if (status != napi_ok) goto fail;
+
+  status = converter.Init(env);
   if (status != napi_ok) goto fail;
 
-  for (int idx = 0; idx < ar.size(); idx++) {
+  for (size_t idx = 0; idx < ar.size(); idx++) {
     napi_value member;
 
-    T item = ar.at(idx);
-    status = Converter<T>::ToJS(env, item, &member);
+    if (idx % kHandleScopeChunkSize == 0) {
+      if (chunk_scope != nullptr) {
+        status = napi_close_handle_scope(env, chunk_scope);
+        chunk_scope = nullptr;
+        if (status != napi_ok) goto fail;
+      }
+
+      status = napi_open_handle_scope(env, &chunk_scope);
+      if (status != napi_ok) goto fail;
+    }
+
+    status = converter.ToJS(env, ar[idx], &member);
     if (status != napi_ok) goto fail;
 
     status = napi_set_element(env, res, idx, member);
     if (status != napi_ok) goto fail;
   }
 
+  if (chunk_scope != nullptr) {
+    status = napi_close_handle_scope(env, chunk_scope);
+    chunk_scope = nullptr;
+    if (status != napi_ok) goto fail;
+  }
+
   status = napi_escape_handle(env, scope, res, &res);
   if (status != napi_ok) goto fail;
 
   status = napi_close_escapable_handle_scope(env, scope);
-  if (status != napi_ok) goto fail;
+  if (status != napi_ok) return status;
 
   *result = res;
   return napi_ok;
 fail:
+  if (chunk_scope != nullptr) napi_close_handle_scope(env, chunk_scope);
   napi_close_escapable_handle_scope(env, scope);
   return status;
 }
 
+// Converts the first `size` elements of the array or typed array `ar` one by
+// one.
 template <typename ArrayType, typename T>
 static inline napi_status
-ArrayToNative(napi_env env, napi_value ar, ArrayType* result) {
+ElementsToNative(napi_env env, napi_value ar, uint32_t size, ArrayType* result) {
   napi_status status;
-  napi_handle_scope scope;
-  ArrayType res;
-  uint32_t size;
+  napi_handle_scope scope = nullptr;
+  ElementConverter<T> converter;
 
-  status = napi_open_handle_scope(env, &scope);
-  if (status != napi_ok) return status;
+  // Elements holding JS values, such as those of a sequence of `object`, hold
+  // handles which must outlive this function, so we may not open scopes around
+  // their conversion.
+  const bool use_scopes = !ContainsJSValue<T>::value;
 
-  status = napi_get_array_length(env, ar, &size);
-  if (status != napi_ok) return status;
+  // Convert each element in place, so that no intermediate copy of the
+  // sequence or of its elements is ever made.
+  result->resize(size);
 
-  res.resize(size);
+  status = converter.Init(env);
+  if (status != napi_ok) return status;
 
-  for (int idx = 0; idx < size; idx++) {
+  for (uint32_t idx = 0; idx < size; idx++) {
     napi_value member;
 
+    if (use_scopes && idx % kHandleScopeChunkSize == 0) {
+      if (scope != nullptr) {
+        status = napi_close_handle_scope(env, scope);
+        scope = nullptr;
+        if (status != napi_ok) return status;
+      }
+
+      status = napi_open_handle_scope(env, &scope);
+      if (status != napi_ok) return status;
+    }
+
     status = napi_get_element(env, ar, idx, &member);
     if (status != napi_ok) goto fail;
 
-    status = Converter<T>::ToNative(env, member, &(res.at(idx)));
+    status = converter.ToNative(env, member, &(*result)[idx]);
     if (status != napi_ok) goto fail;
   }
 
-  status = napi_close_handle_scope(env, scope);
-  if (status != napi_ok) goto fail;
-
-  *result = res;
-  return napi_ok;
+  return (scope == nullptr ? napi_ok : napi_close_handle_scope(env, scope));
 fail:
-  napi_close_handle_scope(env, scope);
+  if (scope != nullptr) napi_close_handle_scope(env, scope);
   return status;
 }
 
+// Whether all elements of type `E` convert to `T` with a cast. The cast is
+// undefined for NaN and for floating-point numbers out of the range of `T`.
+template <typename T, typename E>
+struct IsSafeElementConversion :
+    std::integral_constant<bool,
+                           std::is_integral<E>::value ||
+                           (std::is_floating_point<T>::value &&
+                            sizeof(T) >= sizeof(E))> {};
+
+template <typename ArrayType, typename T, typename E>
+static inline bool CopyElements(const void* data,
+                                size_t length,
+                                ArrayType* result,
+                                std::true_type) {
+  const E* elements = static_cast<const E*>(data);
+  result->resize(length);
+  std::copy(elements, elements + length, result->begin());
+  return true;
+}
+
+template <typename ArrayType, typename T, typename E>
+static inline bool
+CopyElements(const void*, size_t, ArrayType*, std::false_type) {
+  return false;
+}
+
+template <typename ArrayType, typename T, typename E>
+static inline bool
+CopyElements(const void* data, size_t length, ArrayType* result) {
+  return CopyElements<ArrayType, T, E>(data,
+                                       length,
+                                       result,
+                                       IsSafeElementConversion<T, E>());
+}
+
+// Converts a typed array to a sequence of numbers by reading its backing store
+// directly rather than by retrieving its elements one by one. Sets `*handled`
+// to false if `ar` is not a typed array. Elements which would not convert to
+// `T` with a cast are instead converted one by one, like those of an array.
+template <typename ArrayType, typename T>
+static inline napi_status
+TypedArrayToNative(napi_env env,
+                   napi_value ar,
+                   ArrayType* result,
+                   bool* handled,
+                   std::true_type) {
+  napi_typedarray_type type;
+  size_t length;
+  void* data;
+
+  napi_status status = napi_is_typedarray(env, ar, handled);
+  if (status != napi_ok || !*handled) return status;
+
+  status = napi_get_typedarray_info(env,
+                                    ar,
+                                    &type,
+                                    &length,
+                                    &data,
+                                    nullptr,
+                                    nullptr);
+  if (status != napi_ok) return status;
+
+  bool copied;
+  switch (type) {
+    case napi_int8_array:
+      copied = CopyElements<ArrayType, T, int8_t>(data, length, result);
+      break;
+    case napi_uint8_array:
+    case napi_uint8_clamped_array:
+      copied = CopyElements<ArrayType, T, uint8_t>(data, length, result);
+      break;
+    case napi_int16_array:
+      copied = CopyElements<ArrayType, T, int16_t>(data, length, result);
+      break;
+    case napi_uint16_array:
+      copied = CopyElements<ArrayType, T, uint16_t>(data, length, result);
+      break;
+    case napi_int32_array:
+      copied = CopyElements<ArrayType, T, int32_t>(data, length, result);
+      break;
+    case napi_uint32_array:
+      copied = CopyElements<ArrayType, T, uint32_t>(data, length, result);
+      break;
+    case napi_float32_array:
+      copied = CopyElements<ArrayType, T, float>(data, length, result);
+      break;
+    case napi_float64_array:
+      copied = CopyElements<ArrayType, T, double>(data, length, result);
+      break;
+    case napi_bigint64_array:
+      copied = CopyElements<ArrayType, T, int64_t>(data, length, result);
+      break;
+    case napi_biguint64_array:
+      copied = CopyElements<ArrayType, T, uint64_t>(data, length, result);
+      break;
+    default:
+      return napi_invalid_arg;
+  }
+
+  if (copied) return napi_ok;
+  return ElementsToNative<ArrayType, T>(env,
+                                        ar,
+                                        static_cast<uint32_t>(length),
+                                        result);
+}
+
+// Sequences of non-numbers are never read from typed arrays.
+template <typename ArrayType, typename T>
+static inline napi_status
+TypedArrayToNative(napi_env,
+                   napi_value,
+                   ArrayType*,
+                   bool* handled,
+                   std::false_type) {
+  *handled = false;
+  return napi_ok;
+}
+
+template <typename ArrayType, typename TypedArrayType>
+static inline napi_status
+ArrayToTypedArray(napi_env env, const ArrayType& ar, napi_value* result) {
+  typedef typename TypedArrayType::element_type E;
+  napi_value arraybuffer;
+  void* data;
+
+  napi_status status = napi_create_arraybuffer(env,
+                                               ar.size() * sizeof(E),
+                                               &data,
+                                               &arraybuffer);
+  if (status != napi_ok) return status;
+
+  std::copy(ar.begin(), ar.end(), static_cast<E*>(data));
+
+  return napi_create_typedarray(env,
+                                TypedArrayType::kArrayType,
+                                ar.size(),
+                                arraybuffer,
+                                0,
+                                result);
+}
+
+template <typename ArrayType, typename T>
+static inline napi_status
+ArrayToNative(napi_env env, napi_value ar, ArrayType* result) {
+  napi_status status;
+  uint32_t size;
+  bool handled;
+
+  status = TypedArrayToNative<ArrayType, T>(env,
+                                            ar,
+                                            result,
+                                            &handled,
+                                            std::is_arithmetic<T>());
+  if (status != napi_ok || handled) return status;
+
+  status = napi_get_array_length(env, ar, &size);
+  if (status != napi_ok) return status;
+
+  return ElementsToNative<ArrayType, T>(env, ar, size, result);
+}
+
 }  // end of namespace details
 
 template <>
@@ -103,6 +393,18 @@ Converter<uint32_t>::ToJS(napi_env env,
   return napi_create_uint32(env, value, result);
 }
 
+template <>
+inline napi_status
+Converter<bool>::ToNative(napi_env env, napi_value value, bool* result) {
+  return napi_get_value_bool(env, value, result);
+}
+
+template <>
+inline napi_status
+Converter<bool>::ToJS(napi_env env, const bool& value, napi_value* result) {
+  return napi_get_boolean(env, value, result);
+}
+
 template <>
 inline napi_status
 Converter<int32_t>::ToNative(napi_env env,
@@ -151,37 +453,74 @@ Converter<double>::ToJS(napi_env env,
   return napi_create_double(env, value, result);
 }
 
-// TODO(gabrielschulhof): DOMString should be utf16, not utf8.
-template <>
-inline napi_status
-Converter<DOMString>::ToNative(napi_env env,
-                               napi_value str,
-                               DOMString* result) {
-  size_t size;
+template <typename T>
+inline Argument<T>::Argument(T& value): value(value) {}
+
+template <typename T>
+inline Argument<T>::operator T&() const & {
+  return value;
+}
+
+template <typename T>
+inline Argument<T>::operator T&&() && {
+  return std::move(value);
+}
 
-  napi_status status = napi_get_value_string_utf8(env, str, nullptr, 0, &size);
+template <typename T>
+inline Argument<T> PassArgument(T& value) {
+  return Argument<T>(value);
+}
+
+namespace details {
+
+// Strings of up to this many code units are converted to native via a stack
+// buffer, with a single call to N-API.
+static const size_t kStringBufferSize = 256;
+
+// The most code units N-API leaves unused at the end of the buffer when it
+// truncates a string, which it does on character boundaries.
+static const size_t kMaxCodeUnitsPerCharacter = 4;
+
+template <typename StringType, typename CharType>
+inline napi_status StringToNative(napi_env env,
+                                  napi_value value,
+                                  StringType* result,
+                                  napi_status (*get_value)(napi_env,
+                                                           napi_value,
+                                                           CharType*,
+                                                           size_t,
+                                                           size_t*)) {
+  CharType buffer[kStringBufferSize];
+  size_t length;
+
+  napi_status status =
+      get_value(env, value, buffer, kStringBufferSize, &length);
+  if (status != napi_ok) return status;
+
+  // If the buffer had room for another character, the string was not
+  // truncated.
+  if (length + kMaxCodeUnitsPerCharacter < kStringBufferSize) {
+    result->assign(buffer, length);
+    return napi_ok;
+  }
+
+  status = get_value(env, value, nullptr, 0, &length);
   if (status != napi_ok) return status;
 
-  result->resize(size + 1);
-  status = napi_get_value_string_utf8(env, str,
-                                      const_cast<char*>(result->c_str()),
-                                      size + 1, &size);
+  // Leave room for the terminating null that N-API writes, and drop it after.
+  result->resize(length + 1);
+  status = get_value(env, value, &(*result)[0], length + 1, &length);
   if (status != napi_ok) return status;
 
+  result->resize(length);
   return napi_ok;
 }
 
-template <>
-inline napi_status
-Converter<DOMString>::ToJS(napi_env env,
-                           const DOMString& str,
-                           napi_value* result) {
-  return napi_create_string_utf8(env, str.c_str(), NAPI_AUTO_LENGTH, result);
-}
+}  // end of namespace details
 
 template <>
 inline napi_status
-Converter<object>::ToNative(napi_env env,
+Converter<object>::ToNative(napi_env,
                             napi_value val,
                             object* result) {
   *result = static_cast<object>(val);
@@ -190,7 +529,7 @@ Converter<object>::ToNative(napi_env env,
 
 template <>
 inline napi_status
-Converter<object>::ToJS(napi_env env, const object& val, napi_value* result) {
+Converter<object>::ToJS(napi_env, const object& val, napi_value* result) {
   *result = static_cast<napi_value>(val);
   return napi_ok;
 }
@@ -215,93 +554,239 @@ Converter<unsigned long>::ToJS(napi_env env,
   return Converter<int64_t>::ToJS(env, to_js, result);
 }
 
-inline napi_status IsConstructCall(napi_env env,
-                                   napi_callback_info info,
-                                   const char* ifname,
-                                   bool* result) {
-  napi_value new_target;
-  bool res = true;
-  napi_status status = napi_get_new_target(env, info, &new_target);
+template <typename T, napi_typedarray_type array_type>
+inline TypedArray<T, array_type>::TypedArray():
+    ArrayBufferView(nullptr, 0, array_type) {}
+
+template <typename T, napi_typedarray_type array_type>
+inline TypedArray<T, array_type>::TypedArray(T* elements,
+                                             size_t length,
+                                             napi_finalize finalize_cb,
+                                             void* finalize_hint):
+    ArrayBufferView(elements,
+                    length * sizeof(T),
+                    array_type,
+                    finalize_cb,
+                    finalize_hint) {}
+
+template <typename T, napi_typedarray_type array_type>
+inline T* TypedArray<T, array_type>::elements() const {
+  return static_cast<T*>(data);
+}
+
+template <typename T, napi_typedarray_type array_type>
+inline size_t TypedArray<T, array_type>::length() const {
+  return byte_length / sizeof(T);
+}
+
+template <typename T, napi_typedarray_type array_type>
+inline napi_status
+Converter<TypedArray<T, array_type>>::ToNative(
+    napi_env env,
+    napi_value val,
+    TypedArray<T, array_type>* result) {
+  napi_status status = details::ViewToNative(env, val, result);
   if (status != napi_ok) return status;
 
-  if (new_target == nullptr) {
-    status = napi_throw_error(env,
-                              nullptr,
-                              (std::string("Non-construct calls to the `") +
-                                  ifname + "` constructor are not supported.")
-                                  .c_str());
-    if (status != napi_ok) return status;
-    res = false;
-  }
+  return (result->type == array_type ? napi_ok : napi_invalid_arg);
+}
 
-  *result = res;
-  return status;
+template <typename T, napi_typedarray_type array_type>
+inline napi_status
+Converter<TypedArray<T, array_type>>::ToJS(
+    napi_env env,
+    const TypedArray<T, array_type>& val,
+    napi_value* result) {
+  return details::ViewToJS(env, val, result);
 }
 
+template <size_t arg_count>
 inline napi_status PickSignature(napi_env env,
                                  size_t argc,
                                  napi_value* argv,
-                                 std::vector<webidl_sig> sigs,
-                                 int* sig_idx) {
-  // Advance through the signatures one argument type at a time and mark those
-  // as non-candidates whose signature does not correspond to the sequence of
-  // argument types found in the actual arguments.
-  for (size_t idx = 0; idx < argc; idx++) {
-    napi_valuetype val_type;
-    napi_status status = napi_typeof(env, argv[idx], &val_type);
-    if (status != napi_ok) return status;
-    for (auto& sig: sigs)
-      if (sig.candidate)
-        if (idx >= sig.sig.size() || sig.sig[idx] != val_type)
-          sig.candidate = false;
-  }
-
-  // If any signatures are left marked as candidates, return the first one. We
-  // do not touch `sig_idx` if we do not find a candidate, so the caller can set
-  // it to -1 to be informed after this call completes that no candidate was
-  // found.
-  for (size_t idx = 0; idx < sigs.size(); idx++)
-    if (sigs[idx].candidate) {
-      *sig_idx = idx;
-      break;
-    }
+                                 const SignatureMasks (&masks)[arg_count],
+                                 uint32_t candidates,
+                                 int* sig_idx,
+                                 const InterfaceMask* iface_masks,
+                                 size_t iface_mask_count,
+                                 napi_valuetype* arg_types) {
+  return details::PickSignature(env,
+                                argc,
+                                argv,
+                                masks,
+                                arg_count,
+                                candidates,
+                                sig_idx,
+                                iface_masks,
+                                iface_mask_count,
+                                arg_types);
+}
 
-  return napi_ok;
+template <typename T>
+class Promise<T>::State :
+#if defined(BUILDING_NODE_EXTENSION)
+    public PromiseQueue::Item,
+#endif  // BUILDING_NODE_EXTENSION
+    public std::enable_shared_from_this<Promise<T>::State> {
+ public:
+  ~State();
+  void Resolve(const T& result);
+  void Resolve(T&& result);
+  void Reject(const char* code, const char* message, ErrorType type);
+  napi_status Conclude(napi_env candidate_env);
+  napi_status Settle(napi_env env);
+  napi_value promise = nullptr;
+ private:
+  enum Outcome {
+    kPending, kResolved, kRejected
+  };
+  void Dispatch(std::unique_lock<std::mutex>* lock);
+  napi_status SettleDeferred(napi_env env);
+  std::mutex mutex;
+  Outcome outcome = kPending;
+  bool settled = false;
+  T resolution;
+  const char* code = nullptr;
+  const char* message = nullptr;
+  ErrorType error_type = ErrorType::kError;
+  napi_env env = nullptr;
+  std::thread::id js_thread;
+  napi_deferred deferred = nullptr;
+#if defined(BUILDING_NODE_EXTENSION)
+  std::shared_ptr<PromiseQueue> queue;
+#endif  // BUILDING_NODE_EXTENSION
+};
+
+// A promise which is dropped before it is settled no longer keeps the event
+// loop alive. The last copy of a promise may be dropped on any thread, and the
+// queue can only be released on the JS thread.
+template <typename T>
+Promise<T>::State::~State() {
+#if defined(BUILDING_NODE_EXTENSION)
+  if (!queue || settled) return;
+
+  if (std::this_thread::get_id() == js_thread) {
+    NAPI_CALL_RETURN_VOID(env, queue->RemovePending(env));
+  } else {
+    std::shared_ptr<PromiseQueue> target = queue;
+    target->Push(std::make_shared<PromiseQueue::Task>([target](napi_env env) {
+      return target->RemovePending(env);
+    }));
+  }
+#endif  // BUILDING_NODE_EXTENSION
 }
 
 template <typename T>
-inline void Promise<T>::Resolve(const T& result) {
-  if (state != kPending) return;
+inline void Promise<T>::State::Resolve(const T& result) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (outcome != kPending) return;
   resolution = result;
-  state = kResolved;
-  Conclude();
+  outcome = kResolved;
+  Dispatch(&lock);
 }
 
 template <typename T>
-inline void Promise<T>::Reject() {
-  if (state != kPending) return;
-  state = kRejected;
-  Conclude();
+inline void Promise<T>::State::Resolve(T&& result) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (outcome != kPending) return;
+  resolution = std::move(result);
+  outcome = kResolved;
+  Dispatch(&lock);
+}
+
+template <typename T>
+inline void Promise<T>::State::Reject(const char* new_code,
+                                      const char* new_message,
+                                      ErrorType type) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (outcome != kPending) return;
+  code = new_code;
+  message = new_message;
+  error_type = type;
+  outcome = kRejected;
+  Dispatch(&lock);
 }
 
+// Settles the promise once the outcome is known. If the JS promise has not
+// been created yet, `Conclude()` will settle it. Otherwise, if we are on the JS
+// thread, we settle it right away, and if we are not, we queue it for the JS
+// thread.
 template <typename T>
-inline void Promise<T>::Conclude() {
-  if (env) NAPI_CALL_RETURN_VOID(env, Conclude(env));
+inline void
+Promise<T>::State::Dispatch(std::unique_lock<std::mutex>* lock) {
+  if (env == nullptr) return;
+
+  if (std::this_thread::get_id() == js_thread) {
+    lock->unlock();
+    NAPI_CALL_RETURN_VOID(env, Settle(env));
+#if defined(BUILDING_NODE_EXTENSION)
+  } else if (queue) {
+    std::shared_ptr<PromiseQueue> target = queue;
+    lock->unlock();
+    target->Push(this->shared_from_this());
+#endif  // BUILDING_NODE_EXTENSION
+  }
 }
 
 template <typename T>
-napi_status Promise<T>::Conclude(napi_env candidate_env) {
+napi_status Promise<T>::State::Conclude(napi_env candidate_env) {
   napi_status status;
-  env = (env == nullptr ? candidate_env : env);
+  std::unique_lock<std::mutex> lock(mutex);
+
+  if (env == nullptr) {
+    env = candidate_env;
+    js_thread = std::this_thread::get_id();
+  }
 
   if (env == nullptr) return napi_ok;
 
   if (deferred == nullptr) {
     status = napi_create_promise(env, &deferred, &promise);
     if (status != napi_ok) return status;
+
+    if (outcome == kPending) {
+#if defined(BUILDING_NODE_EXTENSION)
+      status = PromiseQueue::GetCurrent(env, &queue);
+      if (status != napi_ok) return status;
+
+      return queue->AddPending(env);
+#else
+      return napi_ok;
+#endif  // BUILDING_NODE_EXTENSION
+    }
+  }
+
+  lock.unlock();
+  return Settle(env);
+}
+
+// Settles the JS promise on the JS thread. The promise no longer keeps the
+// event loop alive even if settling it fails, since it cannot be settled again.
+template <typename T>
+napi_status Promise<T>::State::Settle(napi_env env) {
+  std::unique_lock<std::mutex> lock(mutex);
+
+  if (settled || outcome == kPending || deferred == nullptr) return napi_ok;
+  settled = true;
+  lock.unlock();
+
+  napi_status status = SettleDeferred(env);
+
+#if defined(BUILDING_NODE_EXTENSION)
+  if (queue) {
+    napi_status release_status = queue->RemovePending(env);
+    if (status == napi_ok) status = release_status;
   }
+#endif  // BUILDING_NODE_EXTENSION
+
+  return status;
+}
+
+template <typename T>
+napi_status Promise<T>::State::SettleDeferred(napi_env env) {
+  napi_status status;
 
-  if (state == kResolved) {
+  if (outcome == kResolved) {
     napi_value js_resolution;
 
     status = Converter<T>::ToJS(env,
@@ -311,16 +796,14 @@ napi_status Promise<T>::Conclude(napi_env candidate_env) {
 
     status = napi_resolve_deferred(env, deferred, js_resolution);
     if (status != napi_ok) return status;
-  } else if (state == kRejected) {
-    napi_value error, message;
+  } else {
+    InstanceData* idata;
+    napi_value error;
 
-    status = napi_create_string_utf8(env,
-                                     "Promise rejected",
-                                     NAPI_AUTO_LENGTH,
-                                     &message);
+    status = InstanceData::GetCurrent(env, &idata);
     if (status != napi_ok) return status;
 
-    status = napi_create_error(env, nullptr, message, &error);
+    status = idata->CreateError(env, error_type, code, message, &error);
     if (status != napi_ok) return status;
 
     status = napi_reject_deferred(env, deferred, error);
@@ -331,171 +814,1309 @@ napi_status Promise<T>::Conclude(napi_env candidate_env) {
 }
 
 template <typename T>
-inline napi_status Promise<T>::ToJS(napi_env env,
-                                    const Promise<T>& promise,
-                                    napi_value* result) {
-  *result = promise.promise;
-  return napi_ok;
+inline Promise<T>::Promise(): state(std::make_shared<State>()) {}
+
+template <typename T>
+inline void Promise<T>::Resolve(const T& result) {
+  state->Resolve(result);
 }
 
 template <typename T>
-inline napi_status
-sequence<T>::ToJS(napi_env env, const sequence<T>& seq, napi_value* result) {
-  return details::ArrayToJS<sequence<T>, T, false>(env, seq, result);
+inline void Promise<T>::Resolve(T&& result) {
+  state->Resolve(std::move(result));
 }
 
 template <typename T>
-inline napi_status
-sequence<T>::ToNative(napi_env env, napi_value val, sequence<T>* result) {
-  return details::ArrayToNative<sequence<T>, T>(env, val, result);
+inline void Promise<T>::Reject() {
+  state->Reject(nullptr, "Promise rejected", ErrorType::kError);
 }
 
 template <typename T>
-inline FrozenArray<T>::FrozenArray(std::initializer_list<T> lst):
-    std::vector<T>(lst) {}
+inline void Promise<T>::Reject(const char* code,
+                               const char* message,
+                               ErrorType type) {
+  state->Reject(code, message, type);
+}
 
 template <typename T>
-inline napi_status
-FrozenArray<T>::ToJS(napi_env env, const FrozenArray<T>& seq, napi_value* result) {
-  return details::ArrayToJS<FrozenArray<T>, T, true>(env, seq, result);
+inline napi_status Promise<T>::Conclude(napi_env env) {
+  return state->Conclude(env);
 }
 
 template <typename T>
-inline napi_status
-FrozenArray<T>::ToNative(napi_env env, napi_value val, FrozenArray<T>* result) {
-  return details::ArrayToNative<FrozenArray<T>, T>(env, val, result);
+inline napi_status Promise<T>::ToJS(napi_env,
+                                    const Promise<T>& promise,
+                                    napi_value* result) {
+  *result = promise.state->promise;
+  return napi_ok;
 }
 
-// We assume that we are in control of the instance data for this add-on. Even
-// so, we also assume that there may be multiple generated files bundled into
-// this add-on, each of which uses `InstanceData` to manage its state. Thus,
-// if no data is set, we set a new instance, and if one is already set, we
-// assume it's an instance of `InstanceData` and use that.
+#if defined(BUILDING_NODE_EXTENSION)
 // static
-inline napi_status
-InstanceData::GetCurrent(napi_env env, InstanceData** result) {
-  void* data = nullptr;
-
-  napi_status status = napi_get_instance_data(env, &data);
-  if (status != napi_ok) return status;
+template <typename T>
+napi_status AsyncCall<T>::Queue(napi_env env,
+                                AsyncCall<T>* call,
+                                const char* name,
+                                size_t keep_alive_count,
+                                const napi_value* keep_alive,
+                                napi_value* promise) {
+  napi_status status;
+  napi_value resource_name;
 
-  if (data == nullptr) {
-    InstanceData* new_data = new InstanceData;
+  // Optional arguments may be missing, so only objects are referenced.
+  call->refs.resize(keep_alive_count, nullptr);
+  for (size_t idx = 0; idx < keep_alive_count; idx++) {
+    napi_valuetype type;
+    status = napi_typeof(env, keep_alive[idx], &type);
+    if (status != napi_ok) goto fail;
+    if (type != napi_object) continue;
 
-    data = static_cast<void*>(new_data);
-    status = napi_set_instance_data(env, data, DestroyInstanceData, nullptr);
-    if (status != napi_ok) {
-      delete new_data;
-      return status;
-    }
+    status = napi_create_reference(env, keep_alive[idx], 1, &call->refs[idx]);
+    if (status != napi_ok) goto fail;
   }
 
-  *result = static_cast<InstanceData*>(data);
-  return napi_ok;
-}
-
-inline void InstanceData::AddConstructor(const char* name, napi_ref ctor) {
-  ctors[name] = ctor;
-}
-
-inline void
-InstanceData::SetData(void* new_data, napi_finalize fin_cb, void* new_hint) {
-  data = new_data;
-  cb = fin_cb;
-  hint = new_hint;
-}
+  status = napi_create_string_utf8(env, name, NAPI_AUTO_LENGTH, &resource_name);
+  if (status != napi_ok) goto fail;
 
-inline void* InstanceData::GetData() {
-  return data;
-}
+  status = napi_create_async_work(env,
+                                  nullptr,
+                                  resource_name,
+                                  ExecuteWork,
+                                  CompleteWork,
+                                  call,
+                                  &call->work);
+  if (status != napi_ok) goto fail;
 
-// static
-inline void
-InstanceData::DestroyInstanceData(napi_env env, void* data, void* hint) {
-  (void) hint;
-  static_cast<InstanceData*>(data)->Destroy(env);
-}
+  status = napi_create_promise(env, &call->deferred, promise);
+  if (status != napi_ok) goto fail;
 
-inline void InstanceData::Destroy(napi_env env) {
-  for (std::pair<const char*, napi_ref> ctor: ctors) {
-    NAPI_CALL_RETURN_VOID(env, napi_delete_reference(env, ctor.second));
+  // If the work cannot be queued, the promise is rejected rather than an
+  // exception thrown.
+  status = napi_queue_async_work(env, call->work);
+  if (status != napi_ok) {
+    status = Settle(env, status, call);
+    call->Destroy(env);
+    return status;
   }
 
-  if (data != nullptr && cb != nullptr) cb(env, data, hint);
+  return napi_ok;
+fail:
+  call->Destroy(env);
+  return status;
 }
 
-inline napi_ref InstanceData::GetConstructor(const char* name) {
-  return ctors[name];
+// static
+template <typename T>
+void AsyncCall<T>::ExecuteWork(napi_env env, void* data) {
+  (void) env;
+  AsyncCall<T>* call = static_cast<AsyncCall<T>*>(data);
+  call->result = call->Execute();
 }
 
 // static
 template <typename T>
-napi_status Wrapping<T>::Create(napi_env env,
-                                napi_value js_rcv,
-                                T* cc_rcv,
-                                size_t same_obj_count) {
-  Wrapping<T>* wrapping = new Wrapping<T>;
-  wrapping->native = cc_rcv;
-  if (same_obj_count > 0)
-    wrapping->refs.resize(same_obj_count, nullptr);
-  return napi_wrap(env, js_rcv, wrapping, Destroy, nullptr, nullptr);
+void AsyncCall<T>::CompleteWork(napi_env env, napi_status status, void* data) {
+  AsyncCall<T>* call = static_cast<AsyncCall<T>*>(data);
+  status = Settle(env, status, call);
+  call->Destroy(env);
+  NAPI_CALL_RETURN_VOID(env, status);
 }
 
+// Fulfills the promise with the result if the work completed, and rejects it
+// otherwise.
 // static
 template <typename T>
-napi_status Wrapping<T>::Retrieve(napi_env env,
-                                  napi_value js_rcv,
-                                  T** cc_rcv,
-                                  int ref_idx,
-                                  napi_value* ref,
-                                  Wrapping<T>** get_wrapping) {
-  void* data = nullptr;
+napi_status
+AsyncCall<T>::Settle(napi_env env, napi_status work_status, AsyncCall* call) {
+  napi_status status;
+  napi_value value;
 
-  napi_status status = napi_unwrap(env, js_rcv, &data);
-  if (status != napi_ok) return status;
+  if (work_status == napi_ok) {
+    status = Converter<T>::ToJS(env,
+                                const_cast<const T&>(call->result),
+                                &value);
+    if (status != napi_ok) return status;
 
-  Wrapping<T>*wrapping = static_cast<Wrapping<T>*>(data);
+    return napi_resolve_deferred(env, call->deferred, value);
+  }
 
-  if (ref_idx >= 0 &&
-      ref_idx < wrapping->refs.size() &&
-      wrapping->refs[ref_idx] != nullptr) {
-    napi_value ref_value = nullptr;
+  // The error carries the name of the status as its code, as do the errors
+  // thrown by the bindings.
+  const size_t status_count =
+      sizeof(details::kStatusNames) / sizeof(*details::kStatusNames);
+  const char* code = nullptr;
+  if (work_status > napi_ok && static_cast<size_t>(work_status) < status_count)
+    code = details::kStatusNames[work_status][0];
 
-    status = napi_get_reference_value(env, wrapping->refs[ref_idx], &ref_value);
-    if (status != napi_ok) return status;
+  InstanceData* idata;
+  status = InstanceData::GetCurrent(env, &idata);
+  if (status != napi_ok) return status;
 
-    if (ref != nullptr) *ref = ref_value;
-  }
+  status = idata->CreateError(env,
+                              ErrorType::kError,
+                              code,
+                              "Promise rejected",
+                              &value);
+  if (status != napi_ok) return status;
 
-  if (get_wrapping != nullptr) *get_wrapping = wrapping;
-  *cc_rcv = wrapping->native;
-  return napi_ok;
+  return napi_reject_deferred(env, call->deferred, value);
 }
 
 template <typename T>
-inline napi_status
-Wrapping<T>::SetRef(napi_env env, int idx, napi_value same_obj) {
-  napi_ref ref;
+void AsyncCall<T>::Destroy(napi_env env) {
+  for (napi_ref ref: refs)
+    if (ref != nullptr)
+      napi_delete_reference(env, ref);
+  if (work != nullptr) napi_delete_async_work(env, work);
+  delete this;
+}
+#endif  // BUILDING_NODE_EXTENSION
 
-  napi_status status = napi_create_reference(env, same_obj, 1, &ref);
-  if (status != napi_ok) return status;
+namespace details {
 
-  refs[idx] = ref;
+inline napi_status ArgumentsToJS(napi_env env, napi_value* argv) {
+  (void) env;
+  (void) argv;
   return napi_ok;
 }
 
-// static
-template <typename T>
-void Wrapping<T>::Destroy(napi_env env, void* data, void* hint) {
-  (void) hint;
-  Wrapping<T>* wrapping = static_cast<Wrapping<T>*>(data);
+template <typename T, typename... Rest>
+inline napi_status ArgumentsToJS(napi_env env,
+                                 napi_value* argv,
+                                 const T& arg,
+                                 const Rest&... rest) {
+  napi_status status = ConverterOf<T>::type::ToJS(env, arg, argv);
+  if (status != napi_ok) return status;
 
-  for (napi_ref ref: wrapping->refs)
-    if (ref != nullptr)
-      NAPI_CALL_RETURN_VOID(env, napi_delete_reference(env, ref));
-  delete wrapping->native;
-  delete wrapping;
+  return ArgumentsToJS(env, argv + 1, rest...);
 }
 
-}  // end of namespace WebIdlNapi
+}  // end of namespace details
+
+// The reference is deleted on the JS thread. If the last copy of the callback
+// is destroyed on another thread, the deletion is queued for the JS thread.
+template <typename R, typename... Args>
+class Callback<R(Args...)>::State {
+ public:
+  ~State();
+  napi_env env = nullptr;
+  napi_ref ref = nullptr;
+  const char* method = nullptr;
+  std::thread::id js_thread;
+#if defined(BUILDING_NODE_EXTENSION)
+  std::shared_ptr<PromiseQueue> queue;
+  std::mutex mutex;
+  std::unique_ptr<std::tuple<Args...>> batch;
+#endif  // BUILDING_NODE_EXTENSION
+};
+
+template <typename R, typename... Args>
+Callback<R(Args...)>::State::~State() {
+  if (ref == nullptr) return;
+
+  if (std::this_thread::get_id() == js_thread) {
+    napi_delete_reference(env, ref);
+#if defined(BUILDING_NODE_EXTENSION)
+  } else if (queue) {
+    napi_ref target = ref;
+    queue->Push(std::make_shared<PromiseQueue::Task>([target](napi_env env) {
+      return napi_delete_reference(env, target);
+    }));
+#endif  // BUILDING_NODE_EXTENSION
+  }
+}
+
+template <typename R, typename... Args>
+napi_status Callback<R(Args...)>::Reset(napi_env env,
+                                        napi_value value,
+                                        const char* method) {
+  napi_status status;
+  napi_valuetype type;
+
+  status = napi_typeof(env, value, &type);
+  if (status != napi_ok) return status;
+
+  if (type != napi_function) {
+    if (method == nullptr) return napi_function_expected;
+    if (type != napi_object) return napi_object_expected;
+  }
+
+  std::shared_ptr<State> new_state = std::make_shared<State>();
+  new_state->env = env;
+  new_state->method = method;
+  new_state->js_thread = std::this_thread::get_id();
+
+#if defined(BUILDING_NODE_EXTENSION)
+  status = PromiseQueue::GetCurrent(env, &new_state->queue);
+  if (status != napi_ok) return status;
+#endif  // BUILDING_NODE_EXTENSION
+
+  status = napi_create_reference(env, value, 1, &new_state->ref);
+  if (status != napi_ok) return status;
+
+  state = new_state;
+  return napi_ok;
+}
+
+template <typename R, typename... Args>
+napi_status
+Callback<R(Args...)>::Value(napi_env env, napi_value* result) const {
+  if (!state) return napi_get_undefined(env, result);
+  return napi_get_reference_value(env, state->ref, result);
+}
+
+// A function is called with `undefined` as its receiver, and the operation of
+// a callback interface is called on its object.
+template <typename R, typename... Args>
+napi_status Callback<R(Args...)>::Invoke(napi_value* result,
+                                         const Args&... args) const {
+  napi_status status;
+  napi_value argv[sizeof...(Args) + 1];
+  napi_value target, func, recv;
+  napi_valuetype type;
+
+  if (!state) return napi_invalid_arg;
+  napi_env env = state->env;
+
+  status = details::ArgumentsToJS(env, argv, args...);
+  if (status != napi_ok) return status;
+
+  status = napi_get_reference_value(env, state->ref, &target);
+  if (status != napi_ok) return status;
+
+  status = napi_typeof(env, target, &type);
+  if (status != napi_ok) return status;
+
+  if (type == napi_function) {
+    func = target;
+    status = napi_get_undefined(env, &recv);
+    if (status != napi_ok) return status;
+  } else {
+    recv = target;
+    status = napi_get_named_property(env, target, state->method, &func);
+    if (status != napi_ok) return status;
+
+    status = napi_typeof(env, func, &type);
+    if (status != napi_ok) return status;
+
+    if (type != napi_function) return napi_function_expected;
+  }
+
+  return napi_call_function(env, recv, func, sizeof...(Args), argv, result);
+}
+
+template <typename R, typename... Args>
+napi_status Callback<R(Args...)>::Call(const Args&... args) const {
+  napi_value result;
+  return Invoke(&result, args...);
+}
+
+template <typename R, typename... Args>
+napi_status Callback<R(Args...)>::CallWithResult(R* result,
+                                                 const Args&... args) const {
+  napi_value js_result;
+  napi_status status = Invoke(&js_result, args...);
+  if (status != napi_ok) return status;
+
+  return details::ConverterOf<R>::type::ToNative(state->env,
+                                                 js_result,
+                                                 result);
+}
+
+#if defined(BUILDING_NODE_EXTENSION)
+// The posted call holds a copy of the callback, and thus its reference, until
+// it is made.
+template <typename R, typename... Args>
+void Callback<R(Args...)>::Post(const Args&... args) const {
+  if (!state) return;
+  Callback<R(Args...)> self = *this;
+  state->queue->Push(
+      std::make_shared<PromiseQueue::Task>([self, args...](napi_env) {
+        return self.Call(args...);
+      }));
+}
+
+template <typename R, typename... Args>
+template <typename T>
+void Callback<R(Args...)>::Append(T&& item) const {
+  static_assert(sizeof...(Args) == 1,
+                "Append() requires a callback taking a single sequence");
+  if (!state) return;
+
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    bool first = !state->batch;
+    if (first) state->batch.reset(new std::tuple<Args...>());
+    std::get<0>(*state->batch).push_back(std::forward<T>(item));
+    if (!first) return;
+  }
+
+  Callback<R(Args...)> self = *this;
+  state->queue->Push(
+      std::make_shared<PromiseQueue::Task>([self](napi_env) {
+        return self.Flush();
+      }));
+}
+
+// Takes the items appended so far, so that those appended during the call
+// post the next call.
+template <typename R, typename... Args>
+napi_status Callback<R(Args...)>::Flush() const {
+  std::unique_ptr<std::tuple<Args...>> batch;
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    batch.swap(state->batch);
+  }
+  if (!batch) return napi_ok;
+  return Call(std::get<0>(*batch));
+}
+#endif  // BUILDING_NODE_EXTENSION
+
+template <typename Sig>
+inline napi_status
+Converter<Callback<Sig>>::ToNative(napi_env env,
+                                   napi_value value,
+                                   Callback<Sig>* result) {
+  return result->Reset(env, value, nullptr);
+}
+
+template <typename Sig>
+inline napi_status
+Converter<Callback<Sig>>::ToJS(napi_env env,
+                               const Callback<Sig>& value,
+                               napi_value* result) {
+  return value.Value(env, result);
+}
+
+template <typename T>
+inline napi_status
+sequence<T>::ToJS(napi_env env, const sequence<T>& seq, napi_value* result) {
+  return details::ArrayToJS<sequence<T>, T, false>(env, seq, result);
+}
+
+template <typename T>
+inline napi_status
+sequence<T>::ToNative(napi_env env, napi_value val, sequence<T>* result) {
+  return details::ArrayToNative<sequence<T>, T>(env, val, result);
+}
+
+template <typename T>
+template <typename ArrayType>
+inline napi_status
+sequence<T>::ToTypedArray(napi_env env,
+                          const sequence<T>& seq,
+                          napi_value* result) {
+  return details::ArrayToTypedArray<sequence<T>, ArrayType>(env, seq, result);
+}
+
+template <typename T>
+inline FrozenArray<T>::FrozenArray(std::initializer_list<T> lst):
+    std::vector<T>(lst) {}
+
+template <typename T>
+inline napi_status
+FrozenArray<T>::ToJS(napi_env env, const FrozenArray<T>& seq, napi_value* result) {
+  return details::ArrayToJS<FrozenArray<T>, T, true>(env, seq, result);
+}
+
+template <typename T>
+inline napi_status
+FrozenArray<T>::ToNative(napi_env env, napi_value val, FrozenArray<T>* result) {
+  return details::ArrayToNative<FrozenArray<T>, T>(env, val, result);
+}
+
+template <typename T>
+template <typename ArrayType>
+inline napi_status
+FrozenArray<T>::ToTypedArray(napi_env env,
+                             const FrozenArray<T>& seq,
+                             napi_value* result) {
+  return details::ArrayToTypedArray<FrozenArray<T>, ArrayType>(env,
+                                                               seq,
+                                                               result);
+}
+
+template <typename T>
+inline Optional<T>::Optional() {}
+
+template <typename T>
+inline Optional<T>::Optional(const T& value) {
+  new (&storage) T(value);
+  engaged = true;
+}
+
+template <typename T>
+inline Optional<T>::Optional(T&& value) {
+  new (&storage) T(std::move(value));
+  engaged = true;
+}
+
+template <typename T>
+inline Optional<T>::Optional(const Optional<T>& other) {
+  if (other.engaged) {
+    new (&storage) T(*other);
+    engaged = true;
+  }
+}
+
+template <typename T>
+inline Optional<T>::Optional(Optional<T>&& other) {
+  if (other.engaged) {
+    new (&storage) T(std::move(*other));
+    engaged = true;
+  }
+}
+
+template <typename T>
+inline Optional<T>::~Optional() {
+  reset();
+}
+
+template <typename T>
+inline Optional<T>& Optional<T>::operator=(const Optional<T>& other) {
+  if (this == &other) return *this;
+  if (other.engaged && engaged) {
+    **this = *other;
+  } else if (other.engaged) {
+    new (&storage) T(*other);
+    engaged = true;
+  } else {
+    reset();
+  }
+  return *this;
+}
+
+template <typename T>
+inline Optional<T>& Optional<T>::operator=(Optional<T>&& other) {
+  if (this == &other) return *this;
+  if (other.engaged && engaged) {
+    **this = std::move(*other);
+  } else if (other.engaged) {
+    new (&storage) T(std::move(*other));
+    engaged = true;
+  } else {
+    reset();
+  }
+  return *this;
+}
+
+template <typename T>
+inline bool Optional<T>::has_value() const {
+  return engaged;
+}
+
+template <typename T>
+inline Optional<T>::operator bool() const {
+  return engaged;
+}
+
+template <typename T>
+inline T& Optional<T>::operator*() {
+  return *reinterpret_cast<T*>(&storage);
+}
+
+template <typename T>
+inline const T& Optional<T>::operator*() const {
+  return *reinterpret_cast<const T*>(&storage);
+}
+
+template <typename T>
+inline T* Optional<T>::operator->() {
+  return reinterpret_cast<T*>(&storage);
+}
+
+template <typename T>
+inline const T* Optional<T>::operator->() const {
+  return reinterpret_cast<const T*>(&storage);
+}
+
+template <typename T>
+inline T& Optional<T>::emplace() {
+  reset();
+  new (&storage) T();
+  engaged = true;
+  return **this;
+}
+
+template <typename T>
+inline void Optional<T>::reset() {
+  if (!engaged) return;
+  reinterpret_cast<T*>(&storage)->~T();
+  engaged = false;
+}
+
+template <typename T>
+inline napi_status
+Converter<Optional<T>>::ToNative(napi_env env,
+                                 napi_value val,
+                                 Optional<T>* result) {
+  napi_valuetype val_type;
+  napi_status status = napi_typeof(env, val, &val_type);
+  if (status != napi_ok) return status;
+
+  if (val_type == napi_undefined) {
+    result->reset();
+    return napi_ok;
+  }
+
+  return details::ConverterOf<T>::type::ToNative(env,
+                                                 val,
+                                                 &result->emplace());
+}
+
+template <typename T>
+inline napi_status
+Converter<Optional<T>>::ToJS(napi_env env,
+                             const Optional<T>& val,
+                             napi_value* result) {
+  if (!val.has_value()) return napi_get_undefined(env, result);
+  return details::ConverterOf<T>::type::ToJS(env, *val, result);
+}
+
+template <typename T>
+inline napi_status
+Converter<Nullable<T>>::ToNative(napi_env env,
+                                 napi_value val,
+                                 Nullable<T>* result) {
+  napi_valuetype val_type;
+  napi_status status = napi_typeof(env, val, &val_type);
+  if (status != napi_ok) return status;
+
+  if (val_type == napi_undefined || val_type == napi_null) {
+    result->reset();
+    return napi_ok;
+  }
+
+  return details::ConverterOf<T>::type::ToNative(env,
+                                                 val,
+                                                 &result->emplace());
+}
+
+template <typename T>
+inline napi_status
+Converter<Nullable<T>>::ToJS(napi_env env,
+                             const Nullable<T>& val,
+                             napi_value* result) {
+  if (!val.has_value()) return napi_get_null(env, result);
+  return details::ConverterOf<T>::type::ToJS(env, *val, result);
+}
+
+template <bool timed>
+inline BindingScope<timed>::BindingScope(napi_env env,
+                                         size_t slot,
+                                         size_t index) {
+  InstanceData* idata;
+  if (InstanceData::GetCurrent(env, &idata) != napi_ok) idata = nullptr;
+  Start(idata, slot, index);
+}
+
+template <bool timed>
+inline BindingScope<timed>::BindingScope(napi_env env,
+                                         napi_callback_info info,
+                                         size_t slot,
+                                         size_t index) {
+  void* data;
+  if (napi_get_cb_info(env, info, nullptr, nullptr, nullptr, &data) != napi_ok)
+    data = nullptr;
+  Start(static_cast<InstanceData*>(data), slot, index);
+}
+
+template <bool timed>
+inline BindingScope<timed>::BindingScope(InstanceData* idata,
+                                         size_t slot,
+                                         size_t index) {
+  Start(idata, slot, index);
+}
+
+template <bool timed>
+inline void
+BindingScope<timed>::Start(InstanceData* idata, size_t slot, size_t index) {
+  stats = (idata == nullptr ? nullptr : idata->GetStats(slot));
+  if (stats != nullptr) stats += index;
+  if (timed) start = std::chrono::steady_clock::now();
+}
+
+template <bool timed>
+inline BindingScope<timed>::~BindingScope() {
+  if (stats == nullptr) return;
+  stats->calls++;
+  if (timed) {
+    uint64_t elapsed = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    size_t bucket = 0;
+    while (bucket + 1 < BindingStats::kHistogramBuckets &&
+           (elapsed >> (bucket + 1)) != 0)
+      bucket++;
+    stats->nanoseconds += elapsed;
+    stats->histogram[bucket]++;
+  }
+}
+
+template <typename T>
+inline Wrapping<T>::Wrapping(T* native, size_t ref_count, BlockPool* pool):
+    details::WrappingBase(native,
+                          &InterfaceTraits<T>::type_tag,
+                          ref_count,
+                          pool) {
+  // The references follow the base class, which must thus be all there is.
+  static_assert(sizeof(Wrapping<T>) == sizeof(details::WrappingBase),
+                "Wrapping<T> must not add members to WrappingBase");
+}
+
+template <typename T>
+inline T* Wrapping<T>::Get() const {
+  return static_cast<T*>(native);
+}
+
+// The offset of the native instance within a block allocated by `New()`.
+// static
+template <typename T>
+inline size_t Wrapping<T>::NativeOffset(size_t same_obj_count) {
+  const size_t size = sizeof(Wrapping<T>) + same_obj_count * sizeof(napi_ref);
+  return (size + alignof(T) - 1) / alignof(T) * alignof(T);
+}
+
+// static
+template <typename T>
+napi_status Wrapping<T>::Create(napi_env env,
+                                napi_value js_rcv,
+                                T* cc_rcv,
+                                size_t same_obj_count) {
+  void* block =
+      ::operator new(sizeof(Wrapping<T>) + same_obj_count * sizeof(napi_ref));
+  return Attach(env,
+                js_rcv,
+                new (block) Wrapping<T>(cc_rcv, same_obj_count, nullptr));
+}
+
+// static
+template <typename T>
+template <typename... Args>
+napi_status Wrapping<T>::New(napi_env env,
+                             InstanceData* idata,
+                             size_t pool_slot,
+                             size_t same_obj_count,
+                             Wrapping<T>** result,
+                             Args&&... args) {
+  static_assert(alignof(T) <= alignof(std::max_align_t),
+                "Over-aligned types cannot be pooled");
+  (void) env;
+  const size_t offset = NativeOffset(same_obj_count);
+  BlockPool* pool = idata->GetPool(pool_slot, offset + sizeof(T));
+  char* block = static_cast<char*>(pool->Allocate());
+
+  T* native = new (block + offset) T(std::forward<Args>(args)...);
+  *result = new (block) Wrapping<T>(native, same_obj_count, pool);
+  return napi_ok;
+}
+
+// static
+template <typename T>
+napi_status Wrapping<T>::Attach(napi_env env,
+                                napi_value js_rcv,
+                                Wrapping<T>* wrapping) {
+  napi_status status = napi_wrap(env,
+                                 js_rcv,
+                                 static_cast<details::WrappingBase*>(wrapping),
+                                 Destroy,
+                                 nullptr,
+                                 nullptr);
+  if (status != napi_ok) {
+    Free(env, wrapping);
+    return status;
+  }
+
+  // The object owns the wrapping from here on, even if tagging fails.
+  return details::TagObject(env, js_rcv, &InterfaceTraits<T>::type_tag);
+}
+
+// static
+template <typename T>
+napi_status Wrapping<T>::Free(napi_env env, Wrapping<T>* wrapping) {
+  napi_status status = wrapping->DeleteRefs(env);
+
+  BlockPool* pool = wrapping->pool;
+  if (pool != nullptr) {
+    wrapping->Get()->~T();
+    wrapping->~Wrapping<T>();
+    pool->Free(wrapping);
+  } else {
+    delete wrapping->Get();
+    wrapping->~Wrapping<T>();
+    ::operator delete(wrapping);
+  }
+
+  return status;
+}
+
+// static
+template <typename T>
+inline napi_status Wrapping<T>::Retrieve(napi_env env,
+                                         napi_value js_rcv,
+                                         T** cc_rcv,
+                                         int ref_idx,
+                                         napi_value* ref,
+                                         Wrapping<T>** get_wrapping) {
+  // Objects wrapping instances of other interfaces are rejected, because their
+  // wrappings do not hold a `T`.
+  details::WrappingBase* base;
+  napi_status status = details::WrappingBase::Retrieve(
+      env, js_rcv, &InterfaceTraits<T>::type_tag, ref_idx, ref, &base);
+  if (status != napi_ok) return status;
+
+  Wrapping<T>* wrapping = static_cast<Wrapping<T>*>(base);
+  if (get_wrapping != nullptr) *get_wrapping = wrapping;
+  *cc_rcv = wrapping->Get();
+  return napi_ok;
+}
+
+// static
+template <typename T>
+inline napi_status Wrapping<T>::RetrieveReceiver(napi_env env,
+                                                 napi_value js_rcv,
+                                                 T** cc_rcv,
+                                                 int ref_idx,
+                                                 napi_value* ref,
+                                                 Wrapping<T>** get_wrapping) {
+#if defined(BUILDING_NODE_EXTENSION)
+  details::WrappingBase* base;
+  napi_status status = details::WrappingBase::RetrieveReceiver(
+      env, js_rcv, &InterfaceTraits<T>::type_tag, ref_idx, ref, &base);
+  if (status != napi_ok) return status;
+
+  Wrapping<T>* wrapping = static_cast<Wrapping<T>*>(base);
+  if (get_wrapping != nullptr) *get_wrapping = wrapping;
+  *cc_rcv = wrapping->Get();
+  return napi_ok;
+#else
+  // Other implementations of N-API need not check the receiver's class.
+  return Retrieve(env, js_rcv, cc_rcv, ref_idx, ref, get_wrapping);
+#endif  // BUILDING_NODE_EXTENSION
+}
+
+// static
+template <typename T>
+void Wrapping<T>::Destroy(napi_env env, void* data, void* hint) {
+  (void) hint;
+  NAPI_CALL_RETURN_VOID(env,
+      Free(env,
+           static_cast<Wrapping<T>*>(
+               static_cast<details::WrappingBase*>(data))));
+}
+
+// The JS iterator objects wrap an instance of this class, which converts the
+// items of the container a batch at a time. Between batches, it remembers only
+// how many results it has returned, and the key of the next item if the
+// container is associative, so that `Seek()` finds the next item anew in the
+// container as it is then.
+template <typename T, IterableType type>
+class Iterable<T, type>::Iterator {
+ public:
+  Iterator(const T* container, Kind kind);
+  static napi_status DefineClass(napi_env env, napi_value* result);
+  static void Finalize(napi_env env, void* data, void* hint);
+  // Returns the item following the results returned so far, or `end()` if
+  // there is none left.
+  iterator Seek() const;
+  // Records that `count` more results have been returned, and that `next`
+  // follows them.
+  void Resume(iterator next, size_t count);
+  napi_ref owner = nullptr;
+  const T* container;
+  size_t index = 0;
+  Kind kind;
+ private:
+  typedef details::AssociativeKey<T> Associative;
+  typedef typename Associative::key_type Key;
+  // How `Seek()` finds the next item: by offsetting `begin()` by the index, by
+  // looking up its key, or by stepping forward from `begin()`.
+  struct ByOffset {};
+  struct ByKey {};
+  struct ByStepping {};
+  typedef typename std::conditional<
+      std::is_base_of<
+          std::random_access_iterator_tag,
+          typename std::iterator_traits<iterator>::iterator_category>::value,
+      ByOffset,
+      typename std::conditional<Associative::value, ByKey, ByStepping>::type>
+          ::type Lookup;
+  static napi_value Construct(napi_env env, napi_callback_info info);
+  static napi_value NextBatch(napi_env env, napi_callback_info info);
+  static napi_status Unwrap(napi_env env,
+                            napi_callback_info info,
+                            size_t* argc,
+                            napi_value* argv,
+                            Iterator** result);
+  iterator Seek(ByOffset) const;
+  iterator Seek(ByKey) const;
+  iterator Seek(ByStepping) const;
+  void Remember(iterator next, ByKey);
+  template <typename Tag>
+  void Remember(iterator next, Tag);
+  template <typename It>
+  static const Key& KeyOf(It it, std::true_type);
+  template <typename It>
+  static const Key& KeyOf(It it, std::false_type);
+  Key next_key;
+  bool has_next_key = false;
+};
+
+template <typename T, IterableType type>
+const size_t Iterable<T, type>::slot = InstanceData::NewSlot();
+
+template <typename T, IterableType type>
+inline Iterable<T, type>::Iterator::Iterator(const T* container, Kind kind):
+    container(container), kind(kind) {}
+
+// The class has only the native `nextBatch(n)`, on top of which
+// `DefineIteratorPrototype()` defines the methods JS calls.
+// static
+template <typename T, IterableType type>
+napi_status
+Iterable<T, type>::Iterator::DefineClass(napi_env env, napi_value* result) {
+  napi_status status;
+  InstanceData* idata;
+  napi_value ctor;
+  napi_ref ctor_ref;
+  napi_property_descriptor props[1] = {};
+
+  status = InstanceData::GetCurrent(env, &idata);
+  if (status != napi_ok) return status;
+
+  props[0].utf8name = "nextBatch";
+  props[0].method = NextBatch;
+  props[0].attributes = napi_configurable;
+
+  status = napi_define_class(env,
+                             "Iterator",
+                             NAPI_AUTO_LENGTH,
+                             Construct,
+                             nullptr,
+                             1,
+                             props,
+                             &ctor);
+  if (status != napi_ok) return status;
+
+  status = DefineIteratorPrototype(env, ctor);
+  if (status != napi_ok) return status;
+
+  status = napi_create_reference(env, ctor, 1, &ctor_ref);
+  if (status != napi_ok) return status;
+
+  idata->AddConstructor(slot, ctor_ref);
+  *result = ctor;
+  return napi_ok;
+}
+
+// static
+template <typename T, IterableType type>
+void Iterable<T, type>::Iterator::Finalize(napi_env env,
+                                           void* data,
+                                           void* hint) {
+  (void) hint;
+  Iterator* iterator = static_cast<Iterator*>(data);
+  if (iterator->owner != nullptr) napi_delete_reference(env, iterator->owner);
+  delete iterator;
+}
+
+// The iterators are created by `CreateIterator()`, which wraps them.
+// static
+template <typename T, IterableType type>
+napi_value Iterable<T, type>::Iterator::Construct(napi_env env,
+                                                  napi_callback_info info) {
+  napi_value js_rcv;
+  NAPI_CALL(env,
+      napi_get_cb_info(env, info, nullptr, nullptr, &js_rcv, nullptr));
+  return js_rcv;
+}
+
+// Node.js has already checked the receiver against the class, but JS may have
+// constructed it, in which case it wraps nothing.
+// static
+template <typename T, IterableType type>
+napi_status Iterable<T, type>::Iterator::Unwrap(napi_env env,
+                                                napi_callback_info info,
+                                                size_t* argc,
+                                                napi_value* argv,
+                                                Iterator** result) {
+  napi_value js_rcv;
+  void* data;
+
+  napi_status status =
+      napi_get_cb_info(env, info, argc, argv, &js_rcv, nullptr);
+  if (status != napi_ok) return status;
+
+  status = napi_unwrap(env, js_rcv, &data);
+  if (status != napi_ok) return status;
+
+  *result = static_cast<Iterator*>(data);
+  return napi_ok;
+}
+
+template <typename T, IterableType type>
+inline typename Iterable<T, type>::iterator
+Iterable<T, type>::Iterator::Seek() const {
+  return Seek(Lookup());
+}
+
+template <typename T, IterableType type>
+inline void Iterable<T, type>::Iterator::Resume(iterator next, size_t count) {
+  Remember(next, Lookup());
+  index += count;
+}
+
+// Items past the end of a container that has shrunk are not looked up.
+template <typename T, IterableType type>
+inline typename Iterable<T, type>::iterator
+Iterable<T, type>::Iterator::Seek(ByOffset) const {
+  typedef typename std::iterator_traits<iterator>::difference_type Offset;
+  iterator begin = container->begin();
+  size_t size = static_cast<size_t>(container->end() - begin);
+  return begin + static_cast<Offset>(std::min(index, size));
+}
+
+// The next item may have been removed since, or the end may have been reached
+// before items were added, in which case the container is stepped through by
+// index instead.
+template <typename T, IterableType type>
+inline typename Iterable<T, type>::iterator
+Iterable<T, type>::Iterator::Seek(ByKey) const {
+  if (!has_next_key) return Seek(ByStepping());
+  iterator it = container->find(next_key);
+  if (it == container->end()) return Seek(ByStepping());
+  return it;
+}
+
+template <typename T, IterableType type>
+inline typename Iterable<T, type>::iterator
+Iterable<T, type>::Iterator::Seek(ByStepping) const {
+  iterator it = container->begin();
+  iterator end = container->end();
+  for (size_t idx = 0; idx < index && it != end; idx++) ++it;
+  return it;
+}
+
+// The items of a set are their own keys, and those of a map are pairs.
+template <typename T, IterableType type>
+inline void Iterable<T, type>::Iterator::Remember(iterator next, ByKey) {
+  has_next_key = (next != container->end());
+  if (!has_next_key) return;
+  next_key = KeyOf(next,
+      typename std::is_same<
+          Key,
+          typename std::iterator_traits<iterator>::value_type>::type());
+}
+
+template <typename T, IterableType type>
+template <typename Tag>
+inline void Iterable<T, type>::Iterator::Remember(iterator next, Tag) {
+  (void) next;
+}
+
+// static
+template <typename T, IterableType type>
+template <typename It>
+inline const typename Iterable<T, type>::Iterator::Key&
+Iterable<T, type>::Iterator::KeyOf(It it, std::true_type) {
+  return *it;
+}
+
+// static
+template <typename T, IterableType type>
+template <typename It>
+inline const typename Iterable<T, type>::Iterator::Key&
+Iterable<T, type>::Iterator::KeyOf(It it, std::false_type) {
+  return it->first;
+}
+
+// Returns the values of the next `n` results, so that JS need not call into
+// native code for each of them. The reference to the JS object is released
+// once the end is reached, after which no more results are returned, even if
+// the container grows.
+// static
+template <typename T, IterableType type>
+napi_value Iterable<T, type>::Iterator::NextBatch(napi_env env,
+                                                  napi_callback_info info) {
+  Iterator* self;
+  size_t argc = 1;
+  napi_value js_count, result;
+  uint32_t count;
+
+  NAPI_CALL(env, Unwrap(env, info, &argc, &js_count, &self));
+  NAPI_CALL(env, Converter<uint32_t>::ToNative(env, js_count, &count));
+  NAPI_CALL(env, napi_create_array(env, &result));
+  if (self->owner == nullptr) return result;
+
+  iterator it = self->Seek();
+  iterator end = self->container->end();
+  uint32_t idx = 0;
+  for (; idx < count && it != end; idx++, ++it) {
+    napi_handle_scope scope;
+    napi_value value;
+
+    NAPI_CALL(env, napi_open_handle_scope(env, &scope));
+    napi_status status =
+        ItemToJS(env, it, self->index + idx, self->kind, &value);
+    if (status == napi_ok) status = napi_set_element(env, result, idx, value);
+    NAPI_CALL(env, napi_close_handle_scope(env, scope));
+    NAPI_CALL(env, status);
+  }
+  self->Resume(it, idx);
+
+  if (it == end) {
+    napi_status status = napi_delete_reference(env, self->owner);
+    self->owner = nullptr;
+    NAPI_CALL(env, status);
+  }
+
+  return result;
+}
+
+// Retrieves the native instance, and up to `*argc` arguments if `argc` is not
+// nullptr.
+// static
+template <typename T, IterableType type>
+napi_status Iterable<T, type>::Retrieve(napi_env env,
+                                        napi_callback_info info,
+                                        size_t* argc,
+                                        napi_value* argv,
+                                        napi_value* js_rcv,
+                                        const T** cc_rcv) {
+  T* native;
+  napi_status status = napi_get_cb_info(env, info, argc, argv, js_rcv, nullptr);
+  if (status != napi_ok) return status;
+
+  status = Wrapping<T>::RetrieveReceiver(env, *js_rcv, &native);
+  if (status != napi_ok) return status;
+
+  *cc_rcv = native;
+  return napi_ok;
+}
+
+// static
+template <typename T, IterableType type>
+napi_value Iterable<T, type>::CreateIterator(napi_env env,
+                                             napi_callback_info info,
+                                             Kind kind) {
+  napi_value js_rcv, ctor, result;
+  const T* cc_rcv;
+  InstanceData* idata;
+
+  NAPI_CALL(env, Retrieve(env, info, nullptr, nullptr, &js_rcv, &cc_rcv));
+  NAPI_CALL(env, InstanceData::GetCurrent(env, &idata));
+  NAPI_CALL(env,
+      idata->GetConstructor(env, slot, Iterator::DefineClass, &ctor));
+  NAPI_CALL(env, napi_new_instance(env, ctor, 0, nullptr, &result));
+
+  Iterator* iterator = new Iterator(cc_rcv, kind);
+  napi_status status =
+      napi_wrap(env, result, iterator, Iterator::Finalize, nullptr, nullptr);
+  if (status != napi_ok) {
+    delete iterator;
+    NAPI_CALL(env, status);
+  }
+
+  NAPI_CALL(env, napi_create_reference(env, js_rcv, 1, &iterator->owner));
+  return result;
+}
+
+// static
+template <typename T, IterableType type>
+napi_value Iterable<T, type>::Entries(napi_env env, napi_callback_info info) {
+  return CreateIterator(env, info, kEntries);
+}
+
+// static
+template <typename T, IterableType type>
+napi_value Iterable<T, type>::Keys(napi_env env, napi_callback_info info) {
+  return CreateIterator(env, info, kKeys);
+}
+
+// static
+template <typename T, IterableType type>
+napi_value Iterable<T, type>::Values(napi_env env, napi_callback_info info) {
+  return CreateIterator(env, info, kValues);
+}
+
+// Calls the callback with the value, the key, and the object, for each item.
+// static
+template <typename T, IterableType type>
+napi_value Iterable<T, type>::ForEach(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value argv[2], js_rcv;
+  const T* cc_rcv;
+  napi_valuetype callback_type;
+
+  NAPI_CALL(env, Retrieve(env, info, &argc, argv, &js_rcv, &cc_rcv));
+  NAPI_CALL(env, napi_typeof(env, argv[0], &callback_type));
+  if (callback_type != napi_function)
+    NAPI_CALL(env, napi_function_expected);
+
+  // The callback may modify the container, so each item is looked up anew.
+  Iterator cursor(cc_rcv, kValues);
+  for (iterator it = cursor.Seek(); it != cc_rcv->end(); it = cursor.Seek()) {
+    napi_handle_scope scope;
+    napi_value args[3], unused;
+
+    NAPI_CALL(env, napi_open_handle_scope(env, &scope));
+    napi_status status = ValueToJS(env, it, Type(), &args[0]);
+    if (status == napi_ok)
+      status = KeyToJS(env, it, cursor.index, Type(), &args[1]);
+    args[2] = js_rcv;
+    if (status == napi_ok) {
+      cursor.Resume(std::next(it), 1);
+      status = napi_call_function(env, argv[1], argv[0], 3, args, &unused);
+    }
+    NAPI_CALL(env, napi_close_handle_scope(env, scope));
+    NAPI_CALL(env, status);
+  }
+
+  return nullptr;
+}
+
+// static
+template <typename T, IterableType type>
+napi_value Iterable<T, type>::Size(napi_env env, napi_callback_info info) {
+  napi_value js_rcv, result;
+  const T* cc_rcv;
+
+  NAPI_CALL(env, Retrieve(env, info, nullptr, nullptr, &js_rcv, &cc_rcv));
+  NAPI_CALL(env,
+      napi_create_double(env, static_cast<double>(cc_rcv->size()), &result));
+  return result;
+}
+
+// static
+template <typename T, IterableType type>
+napi_value Iterable<T, type>::Has(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value js_key, js_rcv, result;
+  const T* cc_rcv;
+  typename T::key_type key;
+
+  NAPI_CALL(env, Retrieve(env, info, &argc, &js_key, &js_rcv, &cc_rcv));
+  NAPI_CALL(env,
+      details::ConverterOf<typename T::key_type>::type::ToNative(env,
+                                                                 js_key,
+                                                                 &key));
+  NAPI_CALL(env,
+      napi_get_boolean(env, cc_rcv->find(key) != cc_rcv->end(), &result));
+  return result;
+}
+
+// Returns `undefined` for keys that are absent.
+// static
+template <typename T, IterableType type>
+napi_value Iterable<T, type>::Get(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value js_key, js_rcv, result;
+  const T* cc_rcv;
+  typename T::key_type key;
+
+  NAPI_CALL(env, Retrieve(env, info, &argc, &js_key, &js_rcv, &cc_rcv));
+  NAPI_CALL(env,
+      details::ConverterOf<typename T::key_type>::type::ToNative(env,
+                                                                 js_key,
+                                                                 &key));
+  iterator it = cc_rcv->find(key);
+  if (it == cc_rcv->end()) {
+    NAPI_CALL(env, napi_get_undefined(env, &result));
+  } else {
+    NAPI_CALL(env, ValueToJS(env, it, Type(), &result));
+  }
+  return result;
+}
+
+// Entries are arrays holding the key and the value.
+// static
+template <typename T, IterableType type>
+napi_status Iterable<T, type>::ItemToJS(napi_env env,
+                                        iterator it,
+                                        size_t index,
+                                        Kind kind,
+                                        napi_value* result) {
+  napi_status status;
+  napi_value key, value;
+
+  if (kind == kKeys) return KeyToJS(env, it, index, Type(), result);
+  if (kind == kValues) return ValueToJS(env, it, Type(), result);
+
+  status = KeyToJS(env, it, index, Type(), &key);
+  if (status != napi_ok) return status;
+
+  status = ValueToJS(env, it, Type(), &value);
+  if (status != napi_ok) return status;
+
+  status = napi_create_array_with_length(env, 2, result);
+  if (status != napi_ok) return status;
+
+  status = napi_set_element(env, *result, 0, key);
+  if (status != napi_ok) return status;
+
+  return napi_set_element(env, *result, 1, value);
+}
+
+// static
+template <typename T, IterableType type>
+inline napi_status Iterable<T, type>::KeyToJS(napi_env env,
+                                              iterator it,
+                                              size_t index,
+                                              Indexed,
+                                              napi_value* result) {
+  (void) it;
+  return napi_create_double(env, static_cast<double>(index), result);
+}
+
+// static
+template <typename T, IterableType type>
+inline napi_status Iterable<T, type>::KeyToJS(napi_env env,
+                                              iterator it,
+                                              size_t index,
+                                              Set,
+                                              napi_value* result) {
+  (void) index;
+  return ValueToJS(env, it, Set(), result);
+}
+
+// static
+template <typename T, IterableType type>
+inline napi_status Iterable<T, type>::KeyToJS(napi_env env,
+                                              iterator it,
+                                              size_t index,
+                                              Pairs,
+                                              napi_value* result) {
+  (void) index;
+  typedef typename std::remove_const<decltype(it->first)>::type Key;
+  return details::ConverterOf<Key>::type::ToJS(env, it->first, result);
+}
+
+// static
+template <typename T, IterableType type>
+template <typename Tag>
+inline napi_status Iterable<T, type>::ValueToJS(napi_env env,
+                                                iterator it,
+                                                Tag,
+                                                napi_value* result) {
+  typedef typename std::remove_const<
+      typename std::remove_reference<decltype(*it)>::type>::type Value;
+  return details::ConverterOf<Value>::type::ToJS(env, *it, result);
+}
+
+// static
+template <typename T, IterableType type>
+inline napi_status Iterable<T, type>::ValueToJS(napi_env env,
+                                                iterator it,
+                                                Pairs,
+                                                napi_value* result) {
+  typedef typename std::remove_const<decltype(it->second)>::type Value;
+  return details::ConverterOf<Value>::type::ToJS(env, it->second, result);
+}
+
+}  // end of namespace WebIdlNapi
+
+#if !defined(WEBIDL_NAPI_RUNTIME)
+#include "webidl-napi-runtime-inl.h"
+#endif  // !WEBIDL_NAPI_RUNTIME
+
 #endif  // WEBIDL_NAPI_INL_H
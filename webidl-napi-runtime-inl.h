@@ -0,0 +1,1314 @@
+#ifndef WEBIDL_NAPI_RUNTIME_INL_H
+#define WEBIDL_NAPI_RUNTIME_INL_H
+
+// The parts of the implementation which are not templates. They are compiled
+// inline into each file including webidl-napi.h, unless WEBIDL_NAPI_RUNTIME is
+// defined, in which case they are compiled once into the webidl-napi-runtime
+// library.
+
+#include "webidl-napi.h"
+
+namespace WebIdlNapi {
+
+namespace details {
+
+WEBIDL_NAPI_INLINE size_t TypedArrayElementSize(napi_typedarray_type type) {
+  switch (type) {
+    case napi_int8_array:
+    case napi_uint8_array:
+    case napi_uint8_clamped_array:
+      return 1;
+    case napi_int16_array:
+    case napi_uint16_array:
+      return 2;
+    case napi_int32_array:
+    case napi_uint32_array:
+    case napi_float32_array:
+      return 4;
+    default:
+      return 8;
+  }
+}
+
+WEBIDL_NAPI_INLINE napi_status
+ArrayBufferToNative(napi_env env, napi_value val, BufferSource* result) {
+  bool is_arraybuffer;
+
+  napi_status status = napi_is_arraybuffer(env, val, &is_arraybuffer);
+  if (status != napi_ok) return status;
+  if (!is_arraybuffer) return napi_arraybuffer_expected;
+
+  status = napi_get_arraybuffer_info(env,
+                                     val,
+                                     &result->data,
+                                     &result->byte_length);
+  if (status != napi_ok) return status;
+
+  result->type = napi_uint8_array;
+  result->from_js = true;
+  return napi_ok;
+}
+
+// Accepts both typed arrays and `DataView`s. The memory of the latter is
+// treated as bytes.
+WEBIDL_NAPI_INLINE napi_status
+ViewToNative(napi_env env, napi_value val, BufferSource* result) {
+  bool is_view;
+
+  napi_status status = napi_is_typedarray(env, val, &is_view);
+  if (status != napi_ok) return status;
+
+  if (is_view) {
+    size_t length;
+
+    status = napi_get_typedarray_info(env,
+                                      val,
+                                      &result->type,
+                                      &length,
+                                      &result->data,
+                                      nullptr,
+                                      nullptr);
+    if (status != napi_ok) return status;
+
+    result->byte_length = length * TypedArrayElementSize(result->type);
+    result->from_js = true;
+    return napi_ok;
+  }
+
+  status = napi_is_dataview(env, val, &is_view);
+  if (status != napi_ok) return status;
+  if (!is_view) return napi_invalid_arg;
+
+  status = napi_get_dataview_info(env,
+                                  val,
+                                  &result->byte_length,
+                                  &result->data,
+                                  nullptr,
+                                  nullptr);
+  if (status != napi_ok) return status;
+
+  result->type = napi_uint8_array;
+  result->from_js = true;
+  return napi_ok;
+}
+
+// The memory backing external `ArrayBuffer`s, which V8 does not allow to back
+// more than one `ArrayBuffer` at a time. It is shared by all envs, and is never
+// destroyed, because buffers may be finalized during process teardown.
+struct ExternalBuffers {
+  static ExternalBuffers* Get();
+  std::mutex mutex;
+  std::set<void*> data;
+};
+
+WEBIDL_NAPI_INLINE ExternalBuffers* ExternalBuffers::Get() {
+  static ExternalBuffers* buffers = new ExternalBuffers;
+  return buffers;
+}
+
+// The finalizer of the native memory, called once the external `ArrayBuffer`
+// over it is gone. The memory leaves the registry before it is freed, since
+// once freed, its address may be allocated again and returned from another
+// thread.
+struct ExternalFinalizer {
+  static void Finalize(napi_env env, void* data, void* hint);
+  napi_finalize finalize_cb;
+  void* finalize_hint;
+};
+
+// static
+WEBIDL_NAPI_INLINE void
+ExternalFinalizer::Finalize(napi_env env, void* data, void* hint) {
+  ExternalFinalizer* finalizer = static_cast<ExternalFinalizer*>(hint);
+  ExternalBuffers* buffers = ExternalBuffers::Get();
+
+  {
+    std::lock_guard<std::mutex> lock(buffers->mutex);
+    buffers->data.erase(data);
+  }
+
+  if (finalizer->finalize_cb != nullptr)
+    finalizer->finalize_cb(env, data, finalizer->finalize_hint);
+  delete finalizer;
+}
+
+WEBIDL_NAPI_INLINE napi_status
+ArrayBufferToJS(napi_env env, const BufferSource& source, napi_value* result) {
+  napi_status status;
+  ExternalBuffers* buffers = ExternalBuffers::Get();
+  bool claimed;
+  void* copy;
+
+  if (source.data == nullptr)
+    return napi_create_arraybuffer(env, 0, nullptr, result);
+
+  // Memory belonging to JS may be freed along with the buffer it came from,
+  // and the registry has never seen it, so it must not back a new one.
+  if (source.from_js) {
+    claimed = false;
+  } else {
+    std::lock_guard<std::mutex> lock(buffers->mutex);
+    claimed = buffers->data.insert(source.data).second;
+  }
+
+  if (claimed) {
+    ExternalFinalizer* finalizer =
+        new ExternalFinalizer{source.finalize_cb, source.finalize_hint};
+    status = napi_create_external_arraybuffer(env,
+                                              source.data,
+                                              source.byte_length,
+                                              ExternalFinalizer::Finalize,
+                                              finalizer,
+                                              result);
+    if (status == napi_ok) return napi_ok;
+
+    delete finalizer;
+    std::lock_guard<std::mutex> lock(buffers->mutex);
+    buffers->data.erase(source.data);
+  }
+
+  // The memory belongs to JS, already backs a buffer, or external buffers are
+  // not allowed, such as with napi_no_external_buffers_allowed.
+  status = napi_create_arraybuffer(env, source.byte_length, &copy, result);
+  if (status != napi_ok) return status;
+
+  memcpy(copy, source.data, source.byte_length);
+
+  // The copy is now the only buffer, so the memory is no longer needed unless
+  // it backs another buffer.
+  if (claimed && source.finalize_cb != nullptr)
+    source.finalize_cb(env, source.data, source.finalize_hint);
+
+  return napi_ok;
+}
+
+WEBIDL_NAPI_INLINE napi_status
+ViewToJS(napi_env env, const BufferSource& source, napi_value* result) {
+  napi_value arraybuffer;
+
+  napi_status status = ArrayBufferToJS(env, source, &arraybuffer);
+  if (status != napi_ok) return status;
+
+  return napi_create_typedarray(env,
+                                source.type,
+                                source.byte_length /
+                                    TypedArrayElementSize(source.type),
+                                arraybuffer,
+                                0,
+                                result);
+}
+
+}  // end of namespace details
+
+template <>
+WEBIDL_NAPI_INLINE napi_status
+Converter<std::string>::ToNative(napi_env env,
+                                 napi_value str,
+                                 std::string* result) {
+  return details::StringToNative(env, str, result, napi_get_value_string_utf8);
+}
+
+template <>
+WEBIDL_NAPI_INLINE napi_status
+Converter<std::string>::ToJS(napi_env env,
+                             const std::string& str,
+                             napi_value* result) {
+  return napi_create_string_utf8(env, str.data(), str.size(), result);
+}
+
+template <>
+WEBIDL_NAPI_INLINE napi_status
+Converter<std::u16string>::ToNative(napi_env env,
+                                    napi_value str,
+                                    std::u16string* result) {
+  return details::StringToNative(env, str, result, napi_get_value_string_utf16);
+}
+
+template <>
+WEBIDL_NAPI_INLINE napi_status
+Converter<std::u16string>::ToJS(napi_env env,
+                                const std::u16string& str,
+                                napi_value* result) {
+  return napi_create_string_utf16(env, str.data(), str.size(), result);
+}
+
+WEBIDL_NAPI_INLINE ByteString::ByteString(const std::string& other):
+    std::string(other) {}
+
+template <>
+WEBIDL_NAPI_INLINE napi_status
+Converter<ByteString>::ToNative(napi_env env,
+                                napi_value str,
+                                ByteString* result) {
+  return details::StringToNative(env,
+                                 str,
+                                 static_cast<std::string*>(result),
+                                 napi_get_value_string_latin1);
+}
+
+template <>
+WEBIDL_NAPI_INLINE napi_status
+Converter<ByteString>::ToJS(napi_env env,
+                            const ByteString& str,
+                            napi_value* result) {
+  return napi_create_string_latin1(env, str.data(), str.size(), result);
+}
+
+WEBIDL_NAPI_INLINE BufferSource::BufferSource():
+    BufferSource(nullptr, 0) {}
+
+WEBIDL_NAPI_INLINE BufferSource::BufferSource(void* data,
+                                              size_t byte_length,
+                                              napi_typedarray_type type,
+                                              napi_finalize finalize_cb,
+                                              void* finalize_hint):
+    data(data),
+    byte_length(byte_length),
+    type(type),
+    finalize_cb(finalize_cb),
+    finalize_hint(finalize_hint),
+    from_js(false) {}
+
+template <>
+WEBIDL_NAPI_INLINE napi_status
+Converter<BufferSource>::ToNative(napi_env env,
+                                  napi_value val,
+                                  BufferSource* result) {
+  bool is_arraybuffer;
+
+  napi_status status = napi_is_arraybuffer(env, val, &is_arraybuffer);
+  if (status != napi_ok) return status;
+
+  return (is_arraybuffer
+      ? details::ArrayBufferToNative(env, val, result)
+      : details::ViewToNative(env, val, result));
+}
+
+template <>
+WEBIDL_NAPI_INLINE napi_status
+Converter<BufferSource>::ToJS(napi_env env,
+                              const BufferSource& val,
+                              napi_value* result) {
+  return details::ArrayBufferToJS(env, val, result);
+}
+
+template <>
+WEBIDL_NAPI_INLINE napi_status
+Converter<ArrayBuffer>::ToNative(napi_env env,
+                                 napi_value val,
+                                 ArrayBuffer* result) {
+  return details::ArrayBufferToNative(env, val, result);
+}
+
+template <>
+WEBIDL_NAPI_INLINE napi_status
+Converter<ArrayBuffer>::ToJS(napi_env env,
+                             const ArrayBuffer& val,
+                             napi_value* result) {
+  return details::ArrayBufferToJS(env, val, result);
+}
+
+template <>
+WEBIDL_NAPI_INLINE napi_status
+Converter<ArrayBufferView>::ToNative(napi_env env,
+                                     napi_value val,
+                                     ArrayBufferView* result) {
+  return details::ViewToNative(env, val, result);
+}
+
+template <>
+WEBIDL_NAPI_INLINE napi_status
+Converter<ArrayBufferView>::ToJS(napi_env env,
+                                 const ArrayBufferView& val,
+                                 napi_value* result) {
+  return details::ViewToJS(env, val, result);
+}
+
+WEBIDL_NAPI_INLINE napi_status IsConstructCall(napi_env env,
+                                               napi_callback_info info,
+                                               const char* ifname,
+                                               bool* result) {
+  napi_value new_target;
+  bool res = true;
+  napi_status status = napi_get_new_target(env, info, &new_target);
+  if (status != napi_ok) return status;
+
+  if (new_target == nullptr) {
+    status = napi_throw_error(env,
+                              nullptr,
+                              (std::string("Non-construct calls to the `") +
+                                  ifname + "` constructor are not supported.")
+                                  .c_str());
+    if (status != napi_ok) return status;
+    res = false;
+  }
+
+  *result = res;
+  return status;
+}
+
+WEBIDL_NAPI_INLINE napi_status
+CanReplaceAccessors(napi_env env, bool* result) {
+#if defined(BUILDING_NODE_EXTENSION)
+  const napi_node_version* version;
+  napi_status status = napi_get_node_version(env, &version);
+  if (status != napi_ok) return status;
+  *result = (version->major >= 12);
+#else
+  (void) env;
+  *result = true;
+#endif  // BUILDING_NODE_EXTENSION
+  return napi_ok;
+}
+
+WEBIDL_NAPI_INLINE napi_status
+GetIteratorSymbol(napi_env env, napi_value* result) {
+  napi_value global, symbol;
+
+  napi_status status = napi_get_global(env, &global);
+  if (status != napi_ok) return status;
+
+  status = napi_get_named_property(env, global, "Symbol", &symbol);
+  if (status != napi_ok) return status;
+
+  return napi_get_named_property(env, symbol, "iterator", result);
+}
+
+// The buffers of the iterators are kept in a `WeakMap`, so that JS cannot
+// tamper with them. `next()` stops requesting results once a batch comes back
+// short, because the native iterator then has reached the end.
+WEBIDL_NAPI_INLINE napi_status
+DefineIteratorPrototype(napi_env env, napi_value ctor) {
+  static const CachedFunction define_prototype(
+    "(function(proto) {"
+    "  'use strict';"
+    "  const fetch = proto.nextBatch;"
+    "  const buffers = new WeakMap();"
+    "  Object.setPrototypeOf(proto,"
+    "    Object.getPrototypeOf(Object.getPrototypeOf([][Symbol.iterator]())));"
+    "  Object.defineProperties(proto, {"
+    "    next: {"
+    "      configurable: true,"
+    "      writable: true,"
+    "      value: function next() {"
+    "        let buffer = buffers.get(this);"
+    "        if (buffer === undefined ||"
+    "            (buffer.index === buffer.values.length && !buffer.done)) {"
+    "          const count = (buffer === undefined"
+    "            ? 1"
+    "            : Math.min(buffer.values.length * 2, 1024));"
+    "          const values = fetch.call(this, count);"
+    "          buffer = {"
+    "            values: values,"
+    "            index: 0,"
+    "            done: values.length < count"
+    "          };"
+    "          buffers.set(this, buffer);"
+    "        }"
+    "        if (buffer.index === buffer.values.length) {"
+    "          return { value: undefined, done: true };"
+    "        }"
+    "        return { value: buffer.values[buffer.index++], done: false };"
+    "      }"
+    "    },"
+    "    nextBatch: {"
+    "      configurable: true,"
+    "      writable: true,"
+    "      value: function nextBatch(count) {"
+    "        const buffer = buffers.get(this);"
+    "        if (buffer === undefined ||"
+    "            buffer.index === buffer.values.length ||"
+    "            typeof count !== 'number') {"
+    "          return fetch.call(this, count);"
+    "        }"
+    "        const values ="
+    "          buffer.values.slice(buffer.index, buffer.index + count);"
+    "        buffer.index += values.length;"
+    "        return values;"
+    "      }"
+    "    }"
+    "  });"
+    "})");
+  napi_value proto, define, undefined, unused;
+
+  napi_status status = napi_get_named_property(env, ctor, "prototype", &proto);
+  if (status != napi_ok) return status;
+
+  status = define_prototype.Get(env, &define);
+  if (status != napi_ok) return status;
+
+  status = napi_get_undefined(env, &undefined);
+  if (status != napi_ok) return status;
+
+  return napi_call_function(env, undefined, define, 1, &proto, &unused);
+}
+
+WEBIDL_NAPI_INLINE napi_status HasTypeTags(napi_env env, bool* result) {
+#if defined(WEBIDL_NAPI_TYPE_TAGS)
+  // All envs in a process share the same runtime, so ask only once.
+  static std::atomic<int> has_type_tags(-1);
+  int cached = has_type_tags.load();
+  if (cached < 0) {
+    uint32_t version;
+    napi_status status = napi_get_version(env, &version);
+    if (status != napi_ok) return status;
+    cached = (version >= 8 ? 1 : 0);
+    has_type_tags.store(cached);
+  }
+  *result = (cached == 1);
+#else
+  (void) env;
+  *result = false;
+#endif  // WEBIDL_NAPI_TYPE_TAGS
+  return napi_ok;
+}
+
+namespace details {
+
+WEBIDL_NAPI_INLINE napi_status
+TagObject(napi_env env, napi_value object, const TypeTag* tag) {
+#if defined(WEBIDL_NAPI_TYPE_TAGS)
+  bool has_type_tags;
+  napi_status status = HasTypeTags(env, &has_type_tags);
+  if (status != napi_ok || !has_type_tags) return status;
+  return napi_type_tag_object(env, object, tag);
+#else
+  (void) env;
+  (void) object;
+  (void) tag;
+  return napi_ok;
+#endif  // WEBIDL_NAPI_TYPE_TAGS
+}
+
+// Sets `*result` to false only if type tags are available and `object` is not
+// tagged with `tag`.
+WEBIDL_NAPI_INLINE napi_status CheckObjectTag(napi_env env,
+                                              napi_value object,
+                                              const TypeTag* tag,
+                                              bool* result) {
+#if defined(WEBIDL_NAPI_TYPE_TAGS)
+  bool has_type_tags;
+  napi_status status = HasTypeTags(env, &has_type_tags);
+  if (status != napi_ok) return status;
+  if (has_type_tags)
+    return napi_check_object_type_tag(env, object, tag, result);
+#else
+  (void) env;
+  (void) object;
+  (void) tag;
+#endif  // WEBIDL_NAPI_TYPE_TAGS
+  *result = true;
+  return napi_ok;
+}
+
+}  // end of namespace details
+
+namespace details {
+
+WEBIDL_NAPI_INLINE napi_status PickSignature(napi_env env,
+                                             size_t argc,
+                                             napi_value* argv,
+                                             const SignatureMasks* masks,
+                                             size_t arg_count,
+                                             uint32_t candidates,
+                                             int* sig_idx,
+                                             const InterfaceMask* iface_masks,
+                                             size_t iface_mask_count,
+                                             napi_valuetype* arg_types) {
+  napi_status status;
+  bool has_type_tags = false;
+  if (iface_mask_count > 0) {
+    status = HasTypeTags(env, &has_type_tags);
+    if (status != napi_ok) return status;
+  }
+
+  if (arg_types != nullptr)
+    for (size_t idx = argc; idx < arg_count; idx++)
+      arg_types[idx] = napi_undefined;
+
+  // Advance through the arguments, and, for each argument, retain only those
+  // candidates which accept the argument's type at its position. No signature
+  // accepts more than `arg_count` arguments, so if we receive more, there are
+  // no candidates left.
+  for (size_t idx = 0; idx < argc && candidates != 0; idx++) {
+    if (idx >= arg_count) {
+      candidates = 0;
+      break;
+    }
+
+    napi_valuetype val_type;
+    status = napi_typeof(env, argv[idx], &val_type);
+    if (status != napi_ok) return status;
+    if (arg_types != nullptr) arg_types[idx] = val_type;
+
+    uint32_t accepted = masks[idx][val_type];
+
+    // Without type tags, an object matches all the signatures accepting an
+    // object, as though all interfaces were dictionaries.
+    if (val_type == napi_object && has_type_tags) {
+      uint32_t iface_sigs = 0;
+      uint32_t matched = 0;
+      for (size_t mask_idx = 0; mask_idx < iface_mask_count; mask_idx++) {
+        const InterfaceMask& mask = iface_masks[mask_idx];
+        if (mask.position != idx || (mask.signatures & candidates) == 0)
+          continue;
+        iface_sigs |= mask.signatures;
+
+        bool is_instance;
+        status = CheckObjectTag(env, argv[idx], mask.tag, &is_instance);
+        if (status != napi_ok) return status;
+        if (is_instance) matched |= mask.signatures;
+      }
+      accepted = (matched != 0 ? matched : (accepted & ~iface_sigs));
+    }
+
+    candidates &= accepted;
+  }
+
+  // If any signatures are left marked as candidates, return the first one. We
+  // do not touch `sig_idx` if we do not find a candidate, so the caller can set
+  // it to -1 to be informed after this call completes that no candidate was
+  // found.
+  for (int idx = 0; candidates != 0; idx++, candidates >>= 1)
+    if (candidates & 1) {
+      *sig_idx = idx;
+      break;
+    }
+
+  return napi_ok;
+}
+
+}  // end of namespace details
+
+// We assume that we are in control of the instance data for this add-on. Even
+// so, we also assume that there may be multiple generated files bundled into
+// this add-on, each of which uses `InstanceData` to manage its state. Thus,
+// if no data is set, we set a new instance, and if one is already set, we
+// assume it's an instance of `InstanceData` and use that.
+// static
+WEBIDL_NAPI_INLINE napi_status
+InstanceData::GetCurrent(napi_env env, InstanceData** result) {
+  void* data = nullptr;
+
+  napi_status status = napi_get_instance_data(env, &data);
+  if (status != napi_ok) return status;
+
+  if (data == nullptr) {
+    InstanceData* new_data = new InstanceData;
+
+    data = static_cast<void*>(new_data);
+    status = napi_set_instance_data(env, data, DestroyInstanceData, nullptr);
+    if (status != napi_ok) {
+      delete new_data;
+      return status;
+    }
+  }
+
+  *result = static_cast<InstanceData*>(data);
+  return napi_ok;
+}
+
+// Slots identify per-env storage belonging to a piece of generated code. They
+// are allocated process-wide, because the add-on may contain multiple generated
+// files, and each env grows its storage to accommodate the slots it sees.
+// static
+WEBIDL_NAPI_INLINE size_t InstanceData::NewSlot() {
+  static std::atomic<size_t> next_slot(0);
+  return next_slot++;
+}
+
+WEBIDL_NAPI_INLINE void
+InstanceData::AddConstructor(size_t slot, napi_ref ctor) {
+  if (slot >= ctors.size()) ctors.resize(slot + 1, nullptr);
+  ctors[slot] = ctor;
+}
+
+// Generated constructors check for a pending instance before examining their
+// arguments. If one is set for their interface, they wrap it rather than
+// creating a new native instance.
+WEBIDL_NAPI_INLINE void
+InstanceData::SetPendingInstance(size_t slot, void* instance) {
+  pending_slot = slot;
+  pending_instance = instance;
+}
+
+WEBIDL_NAPI_INLINE void* InstanceData::TakePendingInstance(size_t slot) {
+  void* instance = nullptr;
+  if (pending_instance != nullptr && pending_slot == slot) {
+    instance = pending_instance;
+    pending_instance = nullptr;
+  }
+  return instance;
+}
+
+WEBIDL_NAPI_INLINE void
+InstanceData::SetData(void* new_data, napi_finalize fin_cb, void* new_hint) {
+  data = new_data;
+  cb = fin_cb;
+  hint = new_hint;
+}
+
+WEBIDL_NAPI_INLINE void* InstanceData::GetData() {
+  return data;
+}
+
+WEBIDL_NAPI_INLINE napi_status InstanceData::CreateError(napi_env env,
+                                                         ErrorType type,
+                                                         const char* code,
+                                                         const char* message,
+                                                         napi_value* result) {
+  napi_status status;
+  napi_value js_code = nullptr, js_message;
+
+  if (code != nullptr) {
+    status = GetErrorString(env, code, &js_code);
+    if (status != napi_ok) return status;
+  }
+
+  status = GetErrorString(env, message, &js_message);
+  if (status != napi_ok) return status;
+
+  switch (type) {
+    case ErrorType::kTypeError:
+      return napi_create_type_error(env, js_code, js_message, result);
+    case ErrorType::kRangeError:
+      return napi_create_range_error(env, js_code, js_message, result);
+    default:
+      return napi_create_error(env, js_code, js_message, result);
+  }
+}
+
+WEBIDL_NAPI_INLINE napi_status
+InstanceData::GetErrorString(napi_env env,
+                             const char* str,
+                             napi_value* result) {
+  napi_status status;
+  napi_value holder;
+
+  if (error_strings == nullptr) {
+    status = napi_create_array(env, &holder);
+    if (status != napi_ok) return status;
+
+    status = napi_create_reference(env, holder, 1, &error_strings);
+    if (status != napi_ok) return status;
+  } else {
+    status = napi_get_reference_value(env, error_strings, &holder);
+    if (status != napi_ok) return status;
+  }
+
+  auto found = error_indices.find(str);
+  if (found != error_indices.end())
+    return napi_get_element(env, holder, found->second, result);
+
+  status = napi_create_string_utf8(env, str, NAPI_AUTO_LENGTH, result);
+  if (status != napi_ok) return status;
+
+  uint32_t idx = static_cast<uint32_t>(error_indices.size());
+  status = napi_set_element(env, holder, idx, *result);
+  if (status != napi_ok) return status;
+
+  error_indices[str] = idx;
+  return napi_ok;
+}
+
+// static
+WEBIDL_NAPI_INLINE void
+InstanceData::DestroyInstanceData(napi_env env, void* data, void* hint) {
+  (void) hint;
+  static_cast<InstanceData*>(data)->Destroy(env);
+}
+
+WEBIDL_NAPI_INLINE void InstanceData::Destroy(napi_env env) {
+  for (BlockPool* pool: pools)
+    if (pool != nullptr)
+      pool->Orphan();
+
+  for (napi_ref ctor: ctors)
+    if (ctor != nullptr)
+      NAPI_CALL_RETURN_VOID(env, napi_delete_reference(env, ctor));
+
+  for (napi_ref ref: functions)
+    if (ref != nullptr)
+      NAPI_CALL_RETURN_VOID(env, napi_delete_reference(env, ref));
+
+  for (StringCache& cache: strings) {
+    for (napi_ref ref: cache.refs)
+      NAPI_CALL_RETURN_VOID(env, napi_delete_reference(env, ref));
+    if (cache.holder != nullptr)
+      NAPI_CALL_RETURN_VOID(env, napi_delete_reference(env, cache.holder));
+  }
+
+  if (error_strings != nullptr)
+    NAPI_CALL_RETURN_VOID(env, napi_delete_reference(env, error_strings));
+
+  if (data != nullptr && cb != nullptr) cb(env, data, hint);
+}
+
+// Retrieves the constructor in `slot`, calling `define` to create it if this
+// env has not defined the class yet.
+WEBIDL_NAPI_INLINE napi_status
+InstanceData::GetConstructor(napi_env env,
+                             size_t slot,
+                             DefineClass define,
+                             napi_value* result) {
+  if (slot < ctors.size() && ctors[slot] != nullptr)
+    return napi_get_reference_value(env, ctors[slot], result);
+  return define(env, result);
+}
+
+// Returns the pool in `slot`, creating it with blocks of `block_size` bytes the
+// first time it is requested for this env.
+WEBIDL_NAPI_INLINE BlockPool*
+InstanceData::GetPool(size_t slot, size_t block_size) {
+  if (slot >= pools.size()) pools.resize(slot + 1, nullptr);
+  if (pools[slot] == nullptr) pools[slot] = new BlockPool(block_size);
+  return pools[slot];
+}
+
+// Moving the lists of other slots leaves their items in place.
+WEBIDL_NAPI_INLINE void InstanceData::InitStats(size_t slot, size_t count) {
+  if (slot >= stats.size()) stats.resize(slot + 1);
+  if (stats[slot].empty()) stats[slot].resize(count);
+}
+
+WEBIDL_NAPI_INLINE BindingStats* InstanceData::GetStats(size_t slot) {
+  if (slot >= stats.size() || stats[slot].empty()) return nullptr;
+  return stats[slot].data();
+}
+
+// static
+WEBIDL_NAPI_INLINE napi_status BindingStats::Report(napi_env env,
+                                                    size_t slot,
+                                                    const char* const* names,
+                                                    size_t count,
+                                                    bool timed,
+                                                    napi_value* result) {
+  napi_status status;
+  InstanceData* idata;
+
+  status = InstanceData::GetCurrent(env, &idata);
+  if (status != napi_ok) return status;
+
+  status = napi_create_object(env, result);
+  if (status != napi_ok) return status;
+
+  const BindingStats* table = idata->GetStats(slot);
+  for (size_t idx = 0; idx < count; idx++) {
+    // Copy the statistics, because creating JS values may run bindings which
+    // record theirs.
+    BindingStats stats = (table == nullptr ? BindingStats() : table[idx]);
+    napi_value entry, value;
+
+    status = napi_create_object(env, &entry);
+    if (status != napi_ok) return status;
+
+    status = napi_create_double(env, static_cast<double>(stats.calls), &value);
+    if (status != napi_ok) return status;
+
+    status = napi_set_named_property(env, entry, "calls", value);
+    if (status != napi_ok) return status;
+
+    if (timed) {
+      napi_value histogram;
+
+      status = napi_create_double(env,
+                                  static_cast<double>(stats.nanoseconds),
+                                  &value);
+      if (status != napi_ok) return status;
+
+      status = napi_set_named_property(env, entry, "nanoseconds", value);
+      if (status != napi_ok) return status;
+
+      status = napi_create_array_with_length(env,
+                                             kHistogramBuckets,
+                                             &histogram);
+      if (status != napi_ok) return status;
+
+      for (size_t bucket = 0; bucket < kHistogramBuckets; bucket++) {
+        status = napi_create_double(
+            env,
+            static_cast<double>(stats.histogram[bucket]),
+            &value);
+        if (status != napi_ok) return status;
+
+        status = napi_set_element(env, histogram, bucket, value);
+        if (status != napi_ok) return status;
+      }
+
+      status = napi_set_named_property(env, entry, "histogram", histogram);
+      if (status != napi_ok) return status;
+    }
+
+    status = napi_set_named_property(env, *result, names[idx], entry);
+    if (status != napi_ok) return status;
+  }
+
+  return napi_ok;
+}
+
+#if defined(BUILDING_NODE_EXTENSION)
+namespace details {
+
+// Reports a failure which has no JS caller to throw to as an uncaught
+// exception. The exception left pending by the failure is reported if there is
+// one, and an error for `status` is reported otherwise.
+WEBIDL_NAPI_INLINE void ReportUncaught(napi_env env, napi_status status) {
+  napi_value error;
+  ThrowError(env, status, nullptr, nullptr);
+  if (napi_get_and_clear_last_exception(env, &error) != napi_ok) return;
+  napi_fatal_exception(env, error);
+}
+
+}  // end of namespace details
+
+// Returns the queue of the env, creating it and its thread-safe function upon
+// the first request.
+// static
+WEBIDL_NAPI_INLINE napi_status
+PromiseQueue::GetCurrent(napi_env env, std::shared_ptr<PromiseQueue>* result) {
+  napi_status status;
+  InstanceData* idata;
+
+  status = InstanceData::GetCurrent(env, &idata);
+  if (status != napi_ok) return status;
+
+  if (!idata->promise_queue) {
+    std::shared_ptr<PromiseQueue> queue = std::make_shared<PromiseQueue>();
+    napi_value name, func;
+
+    status = napi_create_string_utf8(env,
+                                     "WebIdlNapi::PromiseQueue",
+                                     NAPI_AUTO_LENGTH,
+                                     &name);
+    if (status != napi_ok) return status;
+
+    // Node.js 10 requires a function even if the call is handled by `CallJS`.
+    status = napi_create_function(env,
+                                  "",
+                                  NAPI_AUTO_LENGTH,
+                                  [](napi_env, napi_callback_info) {
+                                    return static_cast<napi_value>(nullptr);
+                                  },
+                                  nullptr,
+                                  &func);
+    if (status != napi_ok) return status;
+
+    // The thread-safe function holds a strong reference to the queue until it
+    // is finalized, which happens no later than when the env is torn down.
+    std::shared_ptr<PromiseQueue>* finalize_data =
+        new std::shared_ptr<PromiseQueue>(queue);
+    status = napi_create_threadsafe_function(env,
+                                             func,
+                                             nullptr,
+                                             name,
+                                             0,
+                                             1,
+                                             finalize_data,
+                                             Finalize,
+                                             queue.get(),
+                                             CallJS,
+                                             &queue->tsfn);
+    if (status != napi_ok) {
+      delete finalize_data;
+      return status;
+    }
+
+    status = napi_unref_threadsafe_function(env, queue->tsfn);
+    if (status != napi_ok) return status;
+
+    idata->promise_queue = queue;
+  }
+
+  *result = idata->promise_queue;
+  return napi_ok;
+}
+
+WEBIDL_NAPI_INLINE napi_status PromiseQueue::AddPending(napi_env env) {
+  if (pending_count++ == 0)
+    return napi_ref_threadsafe_function(env, tsfn);
+  return napi_ok;
+}
+
+WEBIDL_NAPI_INLINE napi_status PromiseQueue::RemovePending(napi_env env) {
+  // Promises may be dropped once the env has finalized the thread-safe
+  // function.
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (closed) return napi_ok;
+  }
+
+  if (--pending_count == 0)
+    return napi_unref_threadsafe_function(env, tsfn);
+  return napi_ok;
+}
+
+// Only the first item pushed after the JS thread has emptied the queue posts a
+// call to the JS thread. The items pushed after it are settled by that call. If
+// posting the call fails, the next item pushed posts it again.
+WEBIDL_NAPI_INLINE void PromiseQueue::Push(std::shared_ptr<Item> item) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (closed) return;
+  items.push_back(item);
+  if (!posted)
+    posted = (napi_call_threadsafe_function(tsfn,
+                                            nullptr,
+                                            napi_tsfn_nonblocking) == napi_ok);
+}
+
+// static
+WEBIDL_NAPI_INLINE void
+PromiseQueue::CallJS(napi_env env, napi_value func, void* context, void* data) {
+  (void) func;
+  (void) data;
+  PromiseQueue* queue = static_cast<PromiseQueue*>(context);
+  std::vector<std::shared_ptr<Item>> batch;
+
+  // If `env` is null, the thread-safe function is being torn down.
+  if (env == nullptr) return;
+
+  {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    batch.swap(queue->items);
+    queue->posted = false;
+  }
+
+  // A failure to settle an item is reported as an uncaught exception, and the
+  // items after it are settled nonetheless.
+  for (std::shared_ptr<Item>& item: batch) {
+    napi_handle_scope scope;
+    napi_status status = napi_open_handle_scope(env, &scope);
+    if (status == napi_ok) {
+      status = item->Settle(env);
+      napi_status close_status = napi_close_handle_scope(env, scope);
+      if (status == napi_ok) status = close_status;
+    }
+    if (status != napi_ok) details::ReportUncaught(env, status);
+  }
+}
+
+WEBIDL_NAPI_INLINE
+PromiseQueue::Task::Task(std::function<napi_status(napi_env)> run):
+    run(std::move(run)) {}
+
+WEBIDL_NAPI_INLINE napi_status PromiseQueue::Task::Settle(napi_env env) {
+  return run(env);
+}
+
+// static
+WEBIDL_NAPI_INLINE void
+PromiseQueue::Finalize(napi_env env, void* data, void* hint) {
+  (void) env;
+  (void) hint;
+  std::shared_ptr<PromiseQueue>* queue =
+      static_cast<std::shared_ptr<PromiseQueue>*>(data);
+  std::vector<std::shared_ptr<Item>> items;
+
+  // The items are destroyed outside the lock, because a promise destroyed
+  // along with them pushes onto the queue.
+  {
+    std::lock_guard<std::mutex> lock((*queue)->mutex);
+    (*queue)->closed = true;
+    items.swap((*queue)->items);
+  }
+  delete queue;
+}
+#endif  // BUILDING_NODE_EXTENSION
+
+WEBIDL_NAPI_INLINE BlockPool::BlockPool(size_t block_size) {
+  // Each block must be able to hold a link in the list of free blocks, and
+  // must start at an address suitably aligned for any type.
+  const size_t align = alignof(std::max_align_t);
+  block_size = std::max(block_size, sizeof(FreeBlock));
+  this->block_size = (block_size + align - 1) / align * align;
+}
+
+WEBIDL_NAPI_INLINE BlockPool::~BlockPool() {
+  for (void* chunk: chunks) ::operator delete(chunk);
+}
+
+WEBIDL_NAPI_INLINE void* BlockPool::Allocate() {
+  if (free_list == nullptr) {
+    char* chunk =
+        static_cast<char*>(::operator new(block_size * kBlocksPerChunk));
+    chunks.push_back(chunk);
+    for (size_t idx = kBlocksPerChunk; idx > 0; idx--) {
+      FreeBlock* block =
+          reinterpret_cast<FreeBlock*>(chunk + (idx - 1) * block_size);
+      block->next = free_list;
+      free_list = block;
+    }
+  }
+
+  FreeBlock* block = free_list;
+  free_list = block->next;
+  live_count++;
+  return block;
+}
+
+WEBIDL_NAPI_INLINE void BlockPool::Free(void* block) {
+  FreeBlock* free_block = static_cast<FreeBlock*>(block);
+  free_block->next = free_list;
+  free_list = free_block;
+  if (--live_count == 0 && orphaned) delete this;
+}
+
+// Called when the env that owns the pool is torn down. Wrapped objects may yet
+// be finalized afterwards, so the pool deletes itself only once they are.
+WEBIDL_NAPI_INLINE void BlockPool::Orphan() {
+  orphaned = true;
+  if (live_count == 0) delete this;
+}
+
+WEBIDL_NAPI_INLINE CachedStrings::CachedStrings(const char* const* names,
+                                                size_t count):
+    CachedStrings(names, count, false) {}
+
+WEBIDL_NAPI_INLINE CachedStrings::CachedStrings(const char* const* names,
+                                                size_t count,
+                                                bool symbols):
+    names(names),
+    count(count),
+    slot(InstanceData::NewSlot()),
+    symbols(symbols) {}
+
+WEBIDL_NAPI_INLINE CachedSymbols::CachedSymbols(const char* const* names,
+                                                size_t count):
+    CachedStrings(names, count, true) {}
+
+// Retrieves the JS strings into `result`, which must have room for `count`
+// items. The first retrieval for an env creates the strings and references
+// them. Older versions of N-API only allow references to objects, so if we
+// cannot reference the strings themselves we reference an array holding them.
+WEBIDL_NAPI_INLINE napi_status
+CachedStrings::Get(napi_env env, napi_value* result) const {
+  InstanceData* idata;
+  napi_status status;
+
+  if (count == 0) return napi_ok;
+
+  status = InstanceData::GetCurrent(env, &idata);
+  if (status != napi_ok) return status;
+
+  if (slot >= idata->strings.size()) idata->strings.resize(slot + 1);
+  InstanceData::StringCache& cache = idata->strings[slot];
+
+  if (cache.holder != nullptr) {
+    napi_value holder;
+
+    status = napi_get_reference_value(env, cache.holder, &holder);
+    if (status != napi_ok) return status;
+
+    for (size_t idx = 0; idx < count; idx++) {
+      status = napi_get_element(env, holder, idx, &result[idx]);
+      if (status != napi_ok) return status;
+    }
+
+    return napi_ok;
+  }
+
+  if (cache.refs.size() == count) {
+    for (size_t idx = 0; idx < count; idx++) {
+      status = napi_get_reference_value(env, cache.refs[idx], &result[idx]);
+      if (status != napi_ok) return status;
+    }
+
+    return napi_ok;
+  }
+
+  for (size_t idx = 0; idx < count; idx++) {
+    status = napi_create_string_utf8(env,
+                                     names[idx],
+                                     NAPI_AUTO_LENGTH,
+                                     &result[idx]);
+    if (status != napi_ok) return status;
+
+    if (symbols) {
+      status = napi_create_symbol(env, result[idx], &result[idx]);
+      if (status != napi_ok) return status;
+    }
+  }
+
+  cache.refs.resize(count, nullptr);
+  for (size_t idx = 0; idx < count; idx++) {
+    status = napi_create_reference(env, result[idx], 1, &cache.refs[idx]);
+    if (status != napi_ok) break;
+  }
+
+  if (status == napi_ok) return napi_ok;
+
+  for (napi_ref ref: cache.refs)
+    if (ref != nullptr) {
+      status = napi_delete_reference(env, ref);
+      if (status != napi_ok) return status;
+    }
+  cache.refs.clear();
+
+  napi_value holder;
+  status = napi_create_array_with_length(env, count, &holder);
+  if (status != napi_ok) return status;
+
+  for (size_t idx = 0; idx < count; idx++) {
+    status = napi_set_element(env, holder, idx, result[idx]);
+    if (status != napi_ok) return status;
+  }
+
+  return napi_create_reference(env, holder, 1, &cache.holder);
+}
+
+// Retrieves only the JS string at `index`, unless this is the first retrieval
+// for the env.
+WEBIDL_NAPI_INLINE napi_status
+CachedStrings::Get(napi_env env, size_t index, napi_value* result) const {
+  InstanceData* idata;
+  napi_status status = InstanceData::GetCurrent(env, &idata);
+  if (status != napi_ok) return status;
+
+  if (slot < idata->strings.size()) {
+    InstanceData::StringCache& cache = idata->strings[slot];
+
+    if (cache.holder != nullptr) {
+      napi_value holder;
+
+      status = napi_get_reference_value(env, cache.holder, &holder);
+      if (status != napi_ok) return status;
+
+      return napi_get_element(env, holder, index, result);
+    }
+
+    if (cache.refs.size() == count)
+      return napi_get_reference_value(env, cache.refs[index], result);
+  }
+
+  std::vector<napi_value> all(count);
+  status = Get(env, all.data());
+  if (status != napi_ok) return status;
+
+  *result = all[index];
+  return napi_ok;
+}
+
+WEBIDL_NAPI_INLINE CachedFunction::CachedFunction(const char* source):
+    source(source), slot(InstanceData::NewSlot()) {}
+
+WEBIDL_NAPI_INLINE napi_status
+CachedFunction::Get(napi_env env, napi_value* result) const {
+  InstanceData* idata;
+  napi_status status = InstanceData::GetCurrent(env, &idata);
+  if (status != napi_ok) return status;
+
+  if (slot >= idata->functions.size())
+    idata->functions.resize(slot + 1, nullptr);
+
+  if (idata->functions[slot] != nullptr)
+    return napi_get_reference_value(env, idata->functions[slot], result);
+
+  napi_value js_source;
+  status = napi_create_string_utf8(env, source, NAPI_AUTO_LENGTH, &js_source);
+  if (status != napi_ok) return status;
+
+  status = napi_run_script(env, js_source, result);
+  if (status != napi_ok) return status;
+
+  return napi_create_reference(env, *result, 1, &idata->functions[slot]);
+}
+
+namespace details {
+
+WEBIDL_NAPI_INLINE WrappingBase::WrappingBase(void* native,
+                                              const TypeTag* tag,
+                                              size_t ref_count,
+                                              BlockPool* pool):
+    native(native), tag(tag), ref_count(ref_count), pool(pool) {
+  std::fill(refs(), refs() + ref_count, nullptr);
+}
+
+WEBIDL_NAPI_INLINE napi_ref* WrappingBase::refs() {
+  return reinterpret_cast<napi_ref*>(this + 1);
+}
+
+// static
+WEBIDL_NAPI_INLINE napi_status WrappingBase::Retrieve(napi_env env,
+                                                      napi_value js_rcv,
+                                                      const TypeTag* tag,
+                                                      int ref_idx,
+                                                      napi_value* ref,
+                                                      WrappingBase** result) {
+  bool is_instance;
+
+  napi_status status = CheckObjectTag(env, js_rcv, tag, &is_instance);
+  if (status != napi_ok) return status;
+  if (!is_instance) return napi_invalid_arg;
+
+  return RetrieveReceiver(env, js_rcv, tag, ref_idx, ref, result);
+}
+
+// static
+WEBIDL_NAPI_INLINE napi_status
+WrappingBase::RetrieveReceiver(napi_env env,
+                               napi_value js_rcv,
+                               const TypeTag* tag,
+                               int ref_idx,
+                               napi_value* ref,
+                               WrappingBase** result) {
+  void* data = nullptr;
+
+  napi_status status = napi_unwrap(env, js_rcv, &data);
+  if (status != napi_ok) return status;
+
+  WrappingBase* wrapping = static_cast<WrappingBase*>(data);
+  if (wrapping->tag != tag) return napi_invalid_arg;
+
+  if (ref_idx >= 0 &&
+      static_cast<size_t>(ref_idx) < wrapping->ref_count &&
+      wrapping->refs()[ref_idx] != nullptr) {
+    napi_value ref_value = nullptr;
+
+    status =
+        napi_get_reference_value(env, wrapping->refs()[ref_idx], &ref_value);
+    if (status != napi_ok) return status;
+
+    if (ref != nullptr) *ref = ref_value;
+  }
+
+  *result = wrapping;
+  return napi_ok;
+}
+
+// Deletes all the references, even after failing to delete one of them.
+WEBIDL_NAPI_INLINE napi_status WrappingBase::DeleteRefs(napi_env env) {
+  napi_status result = napi_ok;
+  napi_ref* refs = this->refs();
+  for (size_t idx = 0; idx < ref_count; idx++) {
+    if (refs[idx] == nullptr) continue;
+    napi_status status = napi_delete_reference(env, refs[idx]);
+    if (result == napi_ok) result = status;
+  }
+  return result;
+}
+
+WEBIDL_NAPI_INLINE napi_status
+WrappingBase::GetRef(napi_env env, int idx, napi_value* result) {
+  napi_ref ref = refs()[idx];
+  if (ref == nullptr) {
+    *result = nullptr;
+    return napi_ok;
+  }
+  return napi_get_reference_value(env, ref, result);
+}
+
+WEBIDL_NAPI_INLINE napi_status
+WrappingBase::SetRef(napi_env env, int idx, napi_value same_obj) {
+  napi_ref ref;
+
+  napi_status status = napi_create_reference(env, same_obj, 1, &ref);
+  if (status != napi_ok) return status;
+
+  refs()[idx] = ref;
+  return napi_ok;
+}
+
+}  // end of namespace details
+
+}  // end of namespace WebIdlNapi
+
+#endif  // WEBIDL_NAPI_RUNTIME_INL_H
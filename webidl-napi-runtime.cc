@@ -0,0 +1,10 @@
+// The parts of the implementation which are not templates, compiled once for
+// add-ons built with WEBIDL_NAPI_RUNTIME defined. Build it with the same
+// definitions as the add-on, such as BUILDING_NODE_EXTENSION and NAPI_VERSION.
+
+#if !defined(WEBIDL_NAPI_RUNTIME)
+#define WEBIDL_NAPI_RUNTIME
+#endif  // !WEBIDL_NAPI_RUNTIME
+
+#include "webidl-napi.h"
+#include "webidl-napi-runtime-inl.h"
@@ -0,0 +1,17 @@
+# Defines the static library `webidl-napi-runtime`, which holds the parts of
+# the implementation which are not templates. Include this file once REPO_ROOT
+# is set, and link the add-on against the library, which also defines
+# WEBIDL_NAPI_RUNTIME for the add-on. The library is compiled with the
+# definitions of the including directory, so that they match the add-on's.
+add_library(webidl-napi-runtime STATIC ${REPO_ROOT}/webidl-napi-runtime.cc)
+set_target_properties(webidl-napi-runtime PROPERTIES
+  POSITION_INDEPENDENT_CODE ON
+  CXX_VISIBILITY_PRESET hidden
+  VISIBILITY_INLINES_HIDDEN ON)
+# Give each function a section of its own, so that linking the add-on with
+# `--gc-sections` drops the functions it does not use.
+if(CMAKE_CXX_COMPILER_ID MATCHES "GNU|Clang")
+  target_compile_options(webidl-napi-runtime PRIVATE -ffunction-sections -fdata-sections)
+endif()
+target_include_directories(webidl-napi-runtime PUBLIC ${REPO_ROOT} ${CMAKE_JS_INC})
+target_compile_definitions(webidl-napi-runtime PUBLIC WEBIDL_NAPI_RUNTIME)
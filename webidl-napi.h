@@ -1,10 +1,26 @@
 #ifndef WEBIDL_NAPI_H
 #define WEBIDL_NAPI_H
 
+#include <stdint.h>
+#include <stdio.h>
 #include <string.h>
-#include <string>
+#include <algorithm>
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iterator>
+#include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <set>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 // TODO(gabrielschulhof): Once we no longer support Node.js 10, we can
@@ -19,32 +35,50 @@
 // Empty value so that macros here are able to return NULL or void
 #define NAPI_RETVAL_NOTHING  // Intentionally blank #define
 
-// A line that looks like a stack frame from a JS exception
-#define SOURCE_LOCATION                                        \
-  (std::string("\n    at ") + std::string(__func__) +          \
-   std::string(" (" __FILE__ ":") + std::to_string(__LINE__) + \
-   std::string(")"))
+// The location of a failing call, as string literals which cost nothing to
+// compute. Define WEBIDL_NAPI_NO_ERROR_LOCATION to leave the location out of
+// error messages.
+#define WEBIDL_NAPI_STRINGIFY_HELPER(x) #x
+#define WEBIDL_NAPI_STRINGIFY(x) WEBIDL_NAPI_STRINGIFY_HELPER(x)
+#if defined(WEBIDL_NAPI_NO_ERROR_LOCATION)
+#define WEBIDL_NAPI_FUNCTION nullptr
+#define WEBIDL_NAPI_LOCATION nullptr
+#else
+#define WEBIDL_NAPI_FUNCTION __func__
+#define WEBIDL_NAPI_LOCATION __FILE__ ":" WEBIDL_NAPI_STRINGIFY(__LINE__)
+#endif
+
+// Errors are thrown by functions which are never inlined, so that the code for
+// the failure path is not repeated at every call site.
+#if defined(_MSC_VER)
+#define WEBIDL_NAPI_NOINLINE __declspec(noinline)
+#elif defined(__GNUC__)
+#define WEBIDL_NAPI_NOINLINE __attribute__((noinline, cold))
+#else
+#define WEBIDL_NAPI_NOINLINE
+#endif
+
+// The parts of the implementation which are not templates are compiled inline
+// into each file that includes this header. Define WEBIDL_NAPI_RUNTIME to
+// compile them only once, into the webidl-napi-runtime library, and to link
+// against it instead.
+#if defined(WEBIDL_NAPI_RUNTIME)
+#define WEBIDL_NAPI_INLINE
+#else
+#define WEBIDL_NAPI_INLINE inline
+#endif  // WEBIDL_NAPI_RUNTIME
 
 #define GET_AND_THROW_LAST_ERROR(env)                                    \
-  do {                                                                   \
-    const napi_extended_error_info *error_info;                          \
-    napi_get_last_error_info((env), &error_info);                        \
-    bool is_pending;                                                     \
-    napi_is_exception_pending((env), &is_pending);                       \
-    /* If an exception is already pending, don't rethrow it */           \
-    if (!is_pending) {                                                   \
-      const char* error_message = error_info->error_message != NULL ?    \
-        error_info->error_message :                                      \
-        "empty error message";                                           \
-      napi_throw_error((env), NULL, (std::string(error_message) +        \
-          SOURCE_LOCATION).c_str());                                     \
-    }                                                                    \
-  } while (0)
+  WebIdlNapi::ThrowLastError((env), WEBIDL_NAPI_FUNCTION, WEBIDL_NAPI_LOCATION)
 
 #define NAPI_CALL_BASE(env, the_call, ret_val)                           \
   do {                                                                   \
-    if ((the_call) != napi_ok) {                                         \
-      GET_AND_THROW_LAST_ERROR((env));                                   \
+    napi_status webidl_napi_call_status = (the_call);                    \
+    if (webidl_napi_call_status != napi_ok) {                            \
+      WebIdlNapi::ThrowError((env),                                      \
+                             webidl_napi_call_status,                    \
+                             WEBIDL_NAPI_FUNCTION,                       \
+                             WEBIDL_NAPI_LOCATION);                      \
       return ret_val;                                                    \
     }                                                                    \
   } while (0)
@@ -57,29 +91,171 @@
 #define NAPI_CALL_RETURN_VOID(env, the_call)                             \
   NAPI_CALL_BASE(env, the_call, NAPI_RETVAL_NOTHING)
 
-struct webidl_sig {
-  bool candidate;
-  std::vector<napi_valuetype> sig;
-};
-
+// A `DOMString` holds UTF-8 by default. Define WEBIDL_NAPI_UTF16_DOMSTRING to
+// have it hold UTF-16 instead, which JS strings convert to and from without
+// transcoding. `WEBIDL_NAPI_DOMSTRING_LITERAL()` makes a `DOMString` literal of
+// an ASCII string literal, and `WEBIDL_NAPI_DOMSTRING_LITERAL_OF()` picks the
+// one of a UTF-8 and a UTF-16 literal of the same string that `DOMString`
+// holds.
+#if defined(WEBIDL_NAPI_UTF16_DOMSTRING)
+using DOMString = std::u16string;
+#define WEBIDL_NAPI_DOMSTRING_LITERAL(str) u"" str
+#define WEBIDL_NAPI_DOMSTRING_LITERAL_OF(utf8, utf16) utf16
+#else
 using DOMString = std::string;
+#define WEBIDL_NAPI_DOMSTRING_LITERAL(str) str
+#define WEBIDL_NAPI_DOMSTRING_LITERAL_OF(utf8, utf16) utf8
+#endif  // WEBIDL_NAPI_UTF16_DOMSTRING
 using USVString = std::string;
 using object = napi_value;
 using bool_t = bool;
 
 namespace WebIdlNapi {
 
+// Throw an error for a call which returned `status`, unless an exception is
+// already pending. The error's `code` is the name of the status, and its
+// message ends with a line which names `function` and `location` like a frame
+// of a JS stack trace if they are not nullptr. These are templates so that they
+// can be defined in a header without being declared `inline`, which GCC warns
+// about when combined with `noinline` (-Wattributes).
+template <typename Unused = void>
+WEBIDL_NAPI_NOINLINE void ThrowError(napi_env env,
+                                     napi_status status,
+                                     const char* function,
+                                     const char* location);
+// Throw an error for the status of the last call, as `ThrowError()` does.
+template <typename Unused = void>
+WEBIDL_NAPI_NOINLINE void ThrowLastError(napi_env env,
+                                         const char* function,
+                                         const char* location);
+
+// The number of values in the `napi_valuetype` enum.
+static const size_t kValueTypeCount = napi_bigint + 1;
+
+// A row in a generated table describing the signatures of an overloaded
+// operation. There is one row for each argument position. Bit n of the entry at
+// index t of the row is set if signature n accepts a value of type t at that
+// position. Thus, at most 32 signatures are supported.
+typedef uint32_t SignatureMasks[kValueTypeCount];
+
+// The JS objects wrapping the native instances of each interface are tagged,
+// so that they can be told apart from other objects. Type tags are part of
+// N-API 8, and are used only if the headers declare them and the runtime
+// provides them. Define WEBIDL_NAPI_NO_TYPE_TAGS to build with headers which
+// claim N-API 8 but lack type tags.
+#if !defined(WEBIDL_NAPI_NO_TYPE_TAGS) && \
+    defined(NAPI_VERSION_EXPERIMENTAL) && NAPI_VERSION >= 8
+#define WEBIDL_NAPI_TYPE_TAGS
+typedef napi_type_tag TypeTag;
+#else
+struct TypeTag {
+  uint64_t lower;
+  uint64_t upper;
+};
+#endif  // !WEBIDL_NAPI_NO_TYPE_TAGS && NAPI_VERSION >= 8
+
+class InstanceData;
+
+// A converted argument as passed to the native implementation. It binds to a
+// parameter of type `T&` and `const T&` as the argument itself, and is moved
+// into a parameter of type `T` or `T&&`, because the bindings do not use the
+// argument after the call.
+template <typename T>
+class Argument {
+ public:
+  explicit Argument(T& value);
+  operator T&() const &;
+  operator T&&() &&;
+ private:
+  T& value;
+};
+
+template <typename T>
+Argument<T> PassArgument(T& value);
+
+// The generated code defines the tag of each interface, and the conversion of
+// a native instance to a new JS object of its interface. The bindings pass
+// `idata`, which they receive as the data pointer of their callback, so that
+// the conversion need not retrieve it from the env.
+template <typename T>
+struct InterfaceTraits {
+  static const TypeTag type_tag;
+  static napi_status ToJS(napi_env env,
+                          InstanceData* idata,
+                          const T& val,
+                          napi_value* result);
+};
+
+// The signatures which accept an instance of the interface tagged `tag` at
+// argument position `position` of an overloaded operation.
+struct InterfaceMask {
+  size_t position;
+  const TypeTag* tag;
+  uint32_t signatures;
+};
+
+// Signatures whose argument at some position is an interface accept an object
+// there only if it is an instance of that interface. Such signatures are also
+// preferred over those accepting any object there, such as a dictionary. If
+// `arg_types` is not nullptr, it receives the type of each of the `arg_count`
+// arguments, with missing arguments being `napi_undefined`, so that the
+// bindings need not retrieve them again.
+template <size_t arg_count>
 static napi_status
 PickSignature(napi_env env,
               size_t argc,
               napi_value* argv,
-              std::vector<webidl_sig> sigs,
-              int* sig_idx);
+              const SignatureMasks (&masks)[arg_count],
+              uint32_t candidates,
+              int* sig_idx,
+              const InterfaceMask* iface_masks = nullptr,
+              size_t iface_mask_count = 0,
+              napi_valuetype* arg_types = nullptr);
 
-static napi_status IsConstructCall(napi_env env,
-                                   napi_callback_info info,
-                                   const char* ifname,
-                                   bool* result);
+// Sets `*result` to whether type tags are available at runtime.
+napi_status HasTypeTags(napi_env env, bool* result);
+
+napi_status IsConstructCall(napi_env env,
+                            napi_callback_info info,
+                            const char* ifname,
+                            bool* result);
+
+// Whether an accessor may replace itself with a value while it runs, which
+// crashes Node.js 10, where accessors are defined natively. Interfaces are
+// then defined eagerly even with `--lazy-interfaces`.
+napi_status CanReplaceAccessors(napi_env env, bool* result);
+
+// Retrieves `Symbol.iterator`, under which iterable interfaces define the
+// method returning their default iterator.
+napi_status GetIteratorSymbol(napi_env env, napi_value* result);
+
+// Makes the instances of the class of iterators `ctor` inherit from
+// %IteratorPrototype%, and defines their `next()` and `nextBatch(n)` in JS, on
+// top of the native `nextBatch(n)` of the class. Results requested by `next()`
+// are thus fetched in batches, which grow up to 1024 results as iteration
+// proceeds, so that `for...of` calls into native code only once per batch.
+napi_status DefineIteratorPrototype(napi_env env, napi_value ctor);
+
+namespace details {
+
+// The part of `PickSignature()` which does not depend on `arg_count`.
+napi_status PickSignature(napi_env env,
+                          size_t argc,
+                          napi_value* argv,
+                          const SignatureMasks* masks,
+                          size_t arg_count,
+                          uint32_t candidates,
+                          int* sig_idx,
+                          const InterfaceMask* iface_masks,
+                          size_t iface_mask_count,
+                          napi_valuetype* arg_types);
+napi_status TagObject(napi_env env, napi_value object, const TypeTag* tag);
+napi_status CheckObjectTag(napi_env env,
+                           napi_value object,
+                           const TypeTag* tag,
+                           bool* result);
+
+}  // end of namespace details
 
 template <typename T>
 class Converter {
@@ -92,25 +268,331 @@ class Converter {
                           napi_value* result);
 };
 
+// Converts the elements of a sequence with the converter of their type. Some
+// conversions use JS values which are the same for every value converted, such
+// as the keys of the members of a dictionary. `Init()` retrieves them once for
+// all the elements, in the handle scope of the conversion of the sequence, and
+// the generated code specializes this class for each dictionary to do so.
+template <typename T>
+class ElementConverter {
+ public:
+  napi_status Init(napi_env env);
+  napi_status ToNative(napi_env env, napi_value value, T* result);
+  napi_status ToJS(napi_env env, const T& value, napi_value* result);
+};
+
+// A WebIDL `ByteString`, each of whose characters is in the range 0-255 and
+// is stored in one byte. It converts to and from JS via Latin-1.
+class ByteString : public std::string {
+ public:
+  using std::string::string;
+  ByteString() = default;
+  ByteString(const std::string& other);
+};
+
+// A non-owning view of the memory backing a JS `ArrayBuffer` or a view onto
+// one. An instance received from JS is valid only for the duration of the call
+// that received it, and is copied into a new `ArrayBuffer` if it is sent back.
+// Any other instance sent to JS becomes an external `ArrayBuffer` over `data`,
+// and JS calls `finalize_cb`, if set, once it no longer uses the memory.
+// Without `finalize_cb`, the memory must outlive the JS object. If `data`
+// already backs an external `ArrayBuffer`, or if the runtime does not allow
+// external buffers, the memory is copied into a new `ArrayBuffer` instead, and
+// in the latter case `finalize_cb` is called right away.
+struct BufferSource {
+  BufferSource();
+  BufferSource(void* data,
+               size_t byte_length,
+               napi_typedarray_type type = napi_uint8_array,
+               napi_finalize finalize_cb = nullptr,
+               void* finalize_hint = nullptr);
+  void* data;
+  size_t byte_length;
+  // The element type if the memory was received as or is sent as a view.
+  napi_typedarray_type type;
+  napi_finalize finalize_cb;
+  void* finalize_hint;
+  // Whether the memory belongs to JS, because the instance was received from
+  // JS.
+  bool from_js;
+};
+
+struct ArrayBuffer : public BufferSource {
+  using BufferSource::BufferSource;
+};
+
+struct ArrayBufferView : public BufferSource {
+  using BufferSource::BufferSource;
+};
+
+// A view that only accepts typed arrays whose elements are of type `T`.
+template <typename T, napi_typedarray_type array_type>
+struct TypedArray : public ArrayBufferView {
+  typedef T element_type;
+  static const napi_typedarray_type kArrayType = array_type;
+  TypedArray();
+  TypedArray(T* elements,
+             size_t length,
+             napi_finalize finalize_cb = nullptr,
+             void* finalize_hint = nullptr);
+  T* elements() const;
+  size_t length() const;
+};
+
+template <typename T, napi_typedarray_type array_type>
+class Converter<TypedArray<T, array_type>> {
+ public:
+  static napi_status ToNative(napi_env env,
+                              napi_value value,
+                              TypedArray<T, array_type>* result);
+  static napi_status ToJS(napi_env env,
+                          const TypedArray<T, array_type>& value,
+                          napi_value* result);
+};
+
+template <>
+napi_status Converter<std::string>::ToNative(napi_env env,
+                                             napi_value value,
+                                             std::string* result);
+template <>
+napi_status Converter<std::string>::ToJS(napi_env env,
+                                         const std::string& value,
+                                         napi_value* result);
+template <>
+napi_status Converter<std::u16string>::ToNative(napi_env env,
+                                                napi_value value,
+                                                std::u16string* result);
+template <>
+napi_status Converter<std::u16string>::ToJS(napi_env env,
+                                            const std::u16string& value,
+                                            napi_value* result);
+template <>
+napi_status Converter<ByteString>::ToNative(napi_env env,
+                                            napi_value value,
+                                            ByteString* result);
+template <>
+napi_status Converter<ByteString>::ToJS(napi_env env,
+                                        const ByteString& value,
+                                        napi_value* result);
+template <>
+napi_status Converter<BufferSource>::ToNative(napi_env env,
+                                              napi_value value,
+                                              BufferSource* result);
+template <>
+napi_status Converter<BufferSource>::ToJS(napi_env env,
+                                          const BufferSource& value,
+                                          napi_value* result);
+template <>
+napi_status Converter<ArrayBuffer>::ToNative(napi_env env,
+                                             napi_value value,
+                                             ArrayBuffer* result);
+template <>
+napi_status Converter<ArrayBuffer>::ToJS(napi_env env,
+                                         const ArrayBuffer& value,
+                                         napi_value* result);
+template <>
+napi_status Converter<ArrayBufferView>::ToNative(napi_env env,
+                                                 napi_value value,
+                                                 ArrayBufferView* result);
+template <>
+napi_status Converter<ArrayBufferView>::ToJS(napi_env env,
+                                             const ArrayBufferView& value,
+                                             napi_value* result);
+
+namespace details {
+
+napi_status
+ViewToNative(napi_env env, napi_value val, BufferSource* result);
+napi_status
+ViewToJS(napi_env env, const BufferSource& source, napi_value* result);
+
+}  // end of namespace details
+
+using Int8Array = TypedArray<int8_t, napi_int8_array>;
+using Uint8Array = TypedArray<uint8_t, napi_uint8_array>;
+using Uint8ClampedArray = TypedArray<uint8_t, napi_uint8_clamped_array>;
+using Int16Array = TypedArray<int16_t, napi_int16_array>;
+using Uint16Array = TypedArray<uint16_t, napi_uint16_array>;
+using Int32Array = TypedArray<int32_t, napi_int32_array>;
+using Uint32Array = TypedArray<uint32_t, napi_uint32_array>;
+using Float32Array = TypedArray<float, napi_float32_array>;
+using Float64Array = TypedArray<double, napi_float64_array>;
+using BigInt64Array = TypedArray<int64_t, napi_bigint64_array>;
+using BigUint64Array = TypedArray<uint64_t, napi_biguint64_array>;
+
+#if defined(BUILDING_NODE_EXTENSION)
+// Settles promises that were resolved or rejected on threads other than the
+// JS thread, and makes the calls posted to callbacks. Each env has one queue,
+// and all the items pushed onto it between two turns of the event loop are
+// settled in one call on the JS thread. The queue keeps the event loop alive
+// as long as it has pending promises.
+class PromiseQueue {
+ public:
+  class Item {
+   public:
+    virtual ~Item() {}
+    virtual napi_status Settle(napi_env env) = 0;
+  };
+  // Runs a function on the JS thread, such as a call posted to a `Callback`.
+  // A failure of the function, including a JS exception it leaves pending, is
+  // reported as uncaught, and does not prevent the items after it from being
+  // settled.
+  class Task : public Item {
+   public:
+    explicit Task(std::function<napi_status(napi_env)> run);
+    napi_status Settle(napi_env env) override;
+   private:
+    std::function<napi_status(napi_env)> run;
+  };
+  static napi_status
+  GetCurrent(napi_env env, std::shared_ptr<PromiseQueue>* result);
+  // Called on the JS thread for each promise that may be settled via `Push()`,
+  // and for each such promise once it is settled or dropped.
+  napi_status AddPending(napi_env env);
+  napi_status RemovePending(napi_env env);
+  // May be called from any thread.
+  void Push(std::shared_ptr<Item> item);
+ private:
+  static void CallJS(napi_env env, napi_value func, void* context, void* data);
+  static void Finalize(napi_env env, void* data, void* hint);
+  std::mutex mutex;
+  std::vector<std::shared_ptr<Item>> items;
+  napi_threadsafe_function tsfn = nullptr;
+  size_t pending_count = 0;
+  // Whether a call to the JS thread has been posted since it last emptied the
+  // queue.
+  bool posted = false;
+  bool closed = false;
+};
+#endif  // BUILDING_NODE_EXTENSION
+
+// The constructor of an error created by `InstanceData::CreateError()`.
+enum class ErrorType {
+  kError, kTypeError, kRangeError
+};
+
+// A promise whose copies all share the same state, so that the native
+// implementation may keep a copy and settle it later. `Resolve()` and
+// `Reject()` may be called from any thread when building for Node.js, and
+// from the JS thread otherwise.
 template <typename T>
 class Promise {
  public:
+  Promise();
   static napi_status ToJS(napi_env env,
                           const Promise<T>& promise,
                           napi_value* val);
   void Resolve(const T& resolution);
+  void Resolve(T&& resolution);
+  // Rejects the promise with an error whose message is "Promise rejected".
   void Reject();
-  void Conclude();
+  // Rejects the promise with an error of type `type` whose `code` property is
+  // `code`, unless it is nullptr. The strings are not copied, so they must stay
+  // valid until the promise is settled, and `InstanceData::CreateError()` keeps
+  // their JS counterparts for the lifetime of the env, so they should come from
+  // a small set, such as string literals.
+  void Reject(const char* code,
+              const char* message,
+              ErrorType type = ErrorType::kError);
   napi_status Conclude(napi_env env);
  private:
-  enum State {
-    kPending, kResolved, kRejected
-  };
-  State state = kPending;
-  T resolution;
-  napi_env env = nullptr;
-  napi_value promise = nullptr;
+  class State;
+  std::shared_ptr<State> state;
+};
+
+#if defined(BUILDING_NODE_EXTENSION)
+// The call to the native implementation of an operation marked
+// [WebIdlNapiAsync]. Generated code derives from this class to store the
+// converted arguments and to call the native implementation from `Execute()`,
+// which runs on the libuv threadpool. The promise returned to JS is fulfilled
+// with the result on the JS thread. The native receiver and the instances of
+// interfaces passed as arguments remain usable from JS while the call runs, so
+// their implementation must synchronize any state they share with it.
+template <typename T>
+class AsyncCall {
+ public:
+  virtual ~AsyncCall() {}
+  // Takes ownership of `call`. The objects in `keep_alive` are referenced until
+  // the call completes.
+  static napi_status Queue(napi_env env,
+                           AsyncCall<T>* call,
+                           const char* name,
+                           size_t keep_alive_count,
+                           const napi_value* keep_alive,
+                           napi_value* promise);
+ protected:
+  virtual T Execute() = 0;
+ private:
+  static void ExecuteWork(napi_env env, void* data);
+  static void CompleteWork(napi_env env, napi_status status, void* data);
+  static napi_status Settle(napi_env env, napi_status status, AsyncCall* call);
+  void Destroy(napi_env env);
+  napi_async_work work = nullptr;
   napi_deferred deferred = nullptr;
+  std::vector<napi_ref> refs;
+  T result;
+};
+#endif  // BUILDING_NODE_EXTENSION
+
+// A JS function passed to the native implementation for a WebIDL `callback`,
+// or an object implementing a `callback interface`, whose operation `method`
+// is then called on the object unless the object is itself a function. The
+// native implementation declares the type, as in
+// `typedef WebIdlNapi::Callback<DOMString(DOMString)> Transform;`. All copies
+// of a callback share the same reference to the JS value, which is released
+// once the last copy is destroyed. The arguments and the result are converted
+// with their `Converter<T>`.
+template <typename Sig>
+class Callback;
+
+template <typename R, typename... Args>
+class Callback<R(Args...)> {
+ public:
+  // Refers to `value`, which must be a function, or an object if `method` is
+  // not nullptr. Must be called on the JS thread.
+  napi_status Reset(napi_env env, napi_value value, const char* method);
+  // Retrieves the JS value, or `undefined` if the callback is empty.
+  napi_status Value(napi_env env, napi_value* result) const;
+  // Call the JS function in the env of the value, which must be done on its JS
+  // thread. The first form discards the result. If the function throws, they
+  // return `napi_pending_exception` and leave the exception pending, so that
+  // it propagates to JS once the native implementation returns to a binding.
+  napi_status Call(const Args&... args) const;
+  napi_status CallWithResult(R* result, const Args&... args) const;
+#if defined(BUILDING_NODE_EXTENSION)
+  // Calls the JS function with `args` on the JS thread, discarding the result.
+  // May be called from any thread, and does not keep the event loop alive. The
+  // calls posted between two turns of the event loop are made in one batch,
+  // in the order in which they were posted, by the same queue which settles
+  // promises. A JS exception thrown by the function is reported as uncaught.
+  void Post(const Args&... args) const;
+  // For a callback taking a single sequence, appends `item` to the sequence
+  // passed to the next call, so that many native events are delivered to JS
+  // in a single call. Only the first item appended after the previous call
+  // posts the next call. May be called from any thread.
+  template <typename T>
+  void Append(T&& item) const;
+#endif  // BUILDING_NODE_EXTENSION
+ private:
+  class State;
+  napi_status Invoke(napi_value* result, const Args&... args) const;
+#if defined(BUILDING_NODE_EXTENSION)
+  napi_status Flush() const;
+#endif  // BUILDING_NODE_EXTENSION
+  std::shared_ptr<State> state;
+};
+
+// Accepts only functions. Generated code converts the objects implementing a
+// callback interface itself, because it knows the name of their operation.
+template <typename Sig>
+class Converter<Callback<Sig>> {
+ public:
+  static napi_status ToNative(napi_env env,
+                              napi_value value,
+                              Callback<Sig>* result);
+  static napi_status ToJS(napi_env env,
+                          const Callback<Sig>& value,
+                          napi_value* result);
 };
 
 template <typename T>
@@ -120,6 +602,10 @@ class sequence : public std::vector<T> {
   ToJS(napi_env env, const sequence<T>& seq, napi_value* val);
   static napi_status
   ToNative(napi_env env, napi_value val, sequence<T>* result);
+  // Converts a sequence of numbers to a typed array of type `ArrayType`.
+  template <typename ArrayType>
+  static napi_status
+  ToTypedArray(napi_env env, const sequence<T>& seq, napi_value* result);
 };
 
 template <typename T>
@@ -130,46 +616,506 @@ class FrozenArray : public std::vector<T> {
   ToJS(napi_env env, const FrozenArray<T>& seq, napi_value* result);
   static napi_status
   ToNative(napi_env env, napi_value val, FrozenArray<T>* result);
+  template <typename ArrayType>
+  static napi_status
+  ToTypedArray(napi_env env, const FrozenArray<T>& seq, napi_value* result);
+};
+
+// A value which may be absent, stored inline like `std::optional`. An optional
+// argument without a default value is passed to the native implementation as
+// an `Optional<T>`, which is empty if the argument is missing or `undefined`.
+template <typename T>
+class Optional {
+ public:
+  Optional();
+  Optional(const T& value);
+  Optional(T&& value);
+  Optional(const Optional<T>& other);
+  Optional(Optional<T>&& other);
+  ~Optional();
+  Optional<T>& operator=(const Optional<T>& other);
+  Optional<T>& operator=(Optional<T>&& other);
+  bool has_value() const;
+  explicit operator bool() const;
+  T& operator*();
+  const T& operator*() const;
+  T* operator->();
+  const T* operator->() const;
+  // Replaces the value, if any, with a default-constructed one.
+  T& emplace();
+  void reset();
+ private:
+  typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  bool engaged = false;
+};
+
+// The native type of a nullable WebIDL type `T?`, which is empty if the value
+// is `null`. It converts from either `null` or `undefined`, and to `null`.
+template <typename T>
+class Nullable : public Optional<T> {
+ public:
+  using Optional<T>::Optional;
+};
+
+template <typename T>
+class Converter<Optional<T>> {
+ public:
+  static napi_status ToNative(napi_env env,
+                              napi_value value,
+                              Optional<T>* result);
+  static napi_status ToJS(napi_env env,
+                          const Optional<T>& value,
+                          napi_value* result);
+};
+
+template <typename T>
+class Converter<Nullable<T>> {
+ public:
+  static napi_status ToNative(napi_env env,
+                              napi_value value,
+                              Nullable<T>* result);
+  static napi_status ToJS(napi_env env,
+                          const Nullable<T>& value,
+                          napi_value* result);
+};
+
+// Whether native values of type `T` may hold JS values, such as those of type
+// `object`, which remain valid only while the handle scope in which they were
+// created is open. Types not known to hold none are assumed to hold some. The
+// generated code declares which dictionaries and interfaces hold none.
+template <typename T>
+struct ContainsJSValue
+    : public std::integral_constant<bool,
+                                    !std::is_arithmetic<T>::value &&
+                                    !std::is_enum<T>::value> {};
+
+template <>
+struct ContainsJSValue<std::string> : public std::false_type {};
+
+template <>
+struct ContainsJSValue<std::u16string> : public std::false_type {};
+
+template <>
+struct ContainsJSValue<ByteString> : public std::false_type {};
+
+template <>
+struct ContainsJSValue<BufferSource> : public std::false_type {};
+
+template <>
+struct ContainsJSValue<ArrayBuffer> : public std::false_type {};
+
+template <>
+struct ContainsJSValue<ArrayBufferView> : public std::false_type {};
+
+template <typename T, napi_typedarray_type array_type>
+struct ContainsJSValue<TypedArray<T, array_type>>
+    : public std::false_type {};
+
+template <typename Sig>
+struct ContainsJSValue<Callback<Sig>> : public std::false_type {};
+
+template <typename T>
+struct ContainsJSValue<sequence<T>> : public ContainsJSValue<T> {};
+
+template <typename T>
+struct ContainsJSValue<FrozenArray<T>> : public ContainsJSValue<T> {};
+
+template <typename T>
+struct ContainsJSValue<Optional<T>> : public ContainsJSValue<T> {};
+
+template <typename T>
+struct ContainsJSValue<Nullable<T>> : public ContainsJSValue<T> {};
+
+namespace details {
+
+// The class providing the conversions of `T`, which is `T` itself for the
+// generic types.
+template <typename T>
+struct ConverterOf {
+  typedef Converter<T> type;
+};
+
+template <typename T>
+struct ConverterOf<sequence<T>> {
+  typedef sequence<T> type;
+};
+
+template <typename T>
+struct ConverterOf<FrozenArray<T>> {
+  typedef FrozenArray<T> type;
+};
+
+}  // end of namespace details
+
+// A list of strings, such as the member names of a dictionary, that is
+// converted to JS strings only once per env. Generated code declares one such
+// list at file scope for each dictionary and each enum, and retrieves the JS
+// strings via `Get()` once per conversion that needs them as property keys or
+// values, or once per sequence for the elements of a sequence.
+class CachedStrings {
+ public:
+  CachedStrings(const char* const* names, size_t count);
+  napi_status Get(napi_env env, napi_value* result) const;
+  napi_status Get(napi_env env, size_t index, napi_value* result) const;
+ protected:
+  CachedStrings(const char* const* names, size_t count, bool symbols);
+ private:
+  const char* const* names;
+  size_t count;
+  size_t slot;
+  bool symbols;
+};
+
+// Like `CachedStrings`, but holding a new JS symbol for each name, which
+// becomes the description of the symbol. Each env thus has its own symbols,
+// which no other code can use as property keys unless it is handed them.
+class CachedSymbols : public CachedStrings {
+ public:
+  CachedSymbols(const char* const* names, size_t count);
+};
+
+// A JS function that is compiled from `source` only once per env. Generated
+// code uses it to construct objects that all share the same shape.
+class CachedFunction {
+ public:
+  explicit CachedFunction(const char* source);
+  napi_status Get(napi_env env, napi_value* result) const;
+ private:
+  const char* source;
+  size_t slot;
+};
+
+// Hands out blocks of memory of a fixed size, carved from chunks of
+// `kBlocksPerChunk` blocks each. Freed blocks are kept for reuse, and the
+// chunks are released only after the pool is orphaned by the env that owns it
+// and all its blocks have been freed.
+class BlockPool {
+ public:
+  explicit BlockPool(size_t block_size);
+  void* Allocate();
+  void Free(void* block);
+  void Orphan();
+ private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+  static const size_t kBlocksPerChunk = 64;
+  ~BlockPool();
+  size_t block_size;
+  FreeBlock* free_list = nullptr;
+  std::vector<void*> chunks;
+  size_t live_count = 0;
+  bool orphaned = false;
+};
+
+// The statistics recorded for a binding generated with `--instrument`. With
+// `--instrument-timing`, bucket `i` of the histogram counts the calls which
+// took at least 2^i and less than 2^(i + 1) nanoseconds, with the last bucket
+// also counting all longer calls.
+struct BindingStats {
+  static const size_t kHistogramBuckets = 32;
+  // Creates an object which maps each of the `count` names to the statistics
+  // in slot `slot` of the env's `InstanceData` at the index of the name.
+  static napi_status Report(napi_env env,
+                            size_t slot,
+                            const char* const* names,
+                            size_t count,
+                            bool timed,
+                            napi_value* result);
+  uint64_t calls = 0;
+  uint64_t nanoseconds = 0;
+  uint64_t histogram[kHistogramBuckets] = {};
 };
 
 class InstanceData {
  public:
   static napi_status GetCurrent(napi_env env, InstanceData** result);
-  void AddConstructor(const char* name, napi_ref ctor);
-  napi_ref GetConstructor(const char* name);
+  // Defines a JS class and stores its constructor with `AddConstructor()`.
+  typedef napi_status (*DefineClass)(napi_env env, napi_value* result);
+  static size_t NewSlot();
+  void AddConstructor(size_t slot, napi_ref ctor);
+  napi_status GetConstructor(napi_env env,
+                             size_t slot,
+                             DefineClass define,
+                             napi_value* result);
+  void SetPendingInstance(size_t slot, void* instance);
+  void* TakePendingInstance(size_t slot);
+  BlockPool* GetPool(size_t slot, size_t block_size);
+  // Allocates the statistics of the `count` bindings in `slot`, which the
+  // initialization of the module does once per env, so that they never move.
+  void InitStats(size_t slot, size_t count);
+  // Returns the statistics allocated by `InitStats()` for `slot`, indexed by
+  // binding, or nullptr if there are none.
+  BindingStats* GetStats(size_t slot);
   void SetData(void* data, napi_finalize fin_cb, void* hint);
   void* GetData();
+  // Creates an error of type `type` with `message` and, unless it is nullptr,
+  // with `code` as its `code` property. The strings are converted to JS only
+  // once per env, and are afterwards looked up by their contents, so they
+  // should come from a small set, such as string literals.
+  napi_status CreateError(napi_env env,
+                          ErrorType type,
+                          const char* code,
+                          const char* message,
+                          napi_value* result);
  private:
+  friend class CachedStrings;
+  friend class CachedFunction;
+  struct StringCache {
+    std::vector<napi_ref> refs;
+    napi_ref holder = nullptr;
+  };
   static void DestroyInstanceData(napi_env env, void* raw, void* hint);
   void Destroy(napi_env env);
-  std::map<const char*, napi_ref> ctors;
+  std::vector<napi_ref> ctors;
+  size_t pending_slot = 0;
+  void* pending_instance = nullptr;
+  std::vector<BlockPool*> pools;
+  std::vector<std::vector<BindingStats>> stats;
+#if defined(BUILDING_NODE_EXTENSION)
+  friend class PromiseQueue;
+  std::shared_ptr<PromiseQueue> promise_queue;
+#endif  // BUILDING_NODE_EXTENSION
+  std::vector<StringCache> strings;
+  std::vector<napi_ref> functions;
+  napi_status GetErrorString(napi_env env, const char* str, napi_value* result);
+  // Holds the JS strings of `CreateError()` at the indices in `error_indices`,
+  // because older versions of N-API cannot reference strings directly.
+  napi_ref error_strings = nullptr;
+  std::map<std::string, uint32_t> error_indices;
   void* data = nullptr;
   void* hint = nullptr;
   napi_finalize cb = nullptr;
 };
 
+// Records a call to the binding at `index` of the statistics in `slot` when it
+// goes out of scope, along with the time the call took if `timed` is true. The
+// statistics are looked up once, when the scope is created, from the
+// `InstanceData` of the env, from the data of the callback of a binding, which
+// is the `InstanceData`, or from the `InstanceData` given.
+template <bool timed>
+class BindingScope {
+ public:
+  BindingScope(napi_env env, size_t slot, size_t index);
+  BindingScope(napi_env env,
+               napi_callback_info info,
+               size_t slot,
+               size_t index);
+  BindingScope(InstanceData* idata, size_t slot, size_t index);
+  ~BindingScope();
+ private:
+  void Start(InstanceData* idata, size_t slot, size_t index);
+  BindingStats* stats;
+  std::chrono::steady_clock::time_point start;
+};
+
+namespace details {
+
+// The part of `Wrapping<T>` which does not depend on `T`.
+class WrappingBase {
+ public:
+  // Retrieves the value referenced at `idx`, or nullptr if there is none.
+  napi_status GetRef(napi_env env, int idx, napi_value* result);
+  napi_status SetRef(napi_env env, int idx, napi_value same_obj);
+ protected:
+  WrappingBase(void* native,
+               const TypeTag* tag,
+               size_t ref_count,
+               BlockPool* pool);
+  // Retrieves the wrapping of `js_rcv`, which must be tagged with `tag`, and
+  // the value referenced at `ref_idx`, if any, into `ref`.
+  static napi_status Retrieve(napi_env env,
+                              napi_value js_rcv,
+                              const TypeTag* tag,
+                              int ref_idx,
+                              napi_value* ref,
+                              WrappingBase** result);
+  // Like `Retrieve()`, but without checking the type tag of `js_rcv`. Its
+  // wrapping must instead have been created for `tag`, which is only valid for
+  // objects that were wrapped by the bindings.
+  static napi_status RetrieveReceiver(napi_env env,
+                                      napi_value js_rcv,
+                                      const TypeTag* tag,
+                                      int ref_idx,
+                                      napi_value* ref,
+                                      WrappingBase** result);
+  napi_status DeleteRefs(napi_env env);
+  napi_ref* refs();
+  void* native;
+  // The type tag of the interface of `native`.
+  const TypeTag* tag;
+  size_t ref_count;
+  BlockPool* pool;
+};
+
+}  // end of namespace details
+
+// Associates a native instance with the JS object that wraps it, along with
+// the references that back the object's `[SameObject]` attributes. The
+// references are stored right after the wrapping in the same allocation.
 template <typename T>
-class Wrapping {
+class Wrapping : public details::WrappingBase {
  public:
+  // Wraps `cc_rcv`, which must have been allocated with `new`.
   static napi_status Create(napi_env env,
                             napi_value js_rcv,
                             T* cc_rcv,
                             size_t same_obj_count = 0);
+  // Constructs a native instance from `args` in a single block, taken from the
+  // pool stored in slot `pool_slot` of `idata`, the env's `InstanceData`, which
+  // also holds the wrapping and its references. The result must be passed to
+  // `Attach()` or to `Free()`.
+  template <typename... Args>
+  static napi_status New(napi_env env,
+                         InstanceData* idata,
+                         size_t pool_slot,
+                         size_t same_obj_count,
+                         Wrapping<T>** result,
+                         Args&&... args);
+  // Wraps a wrapping created by `New()` into `js_rcv`. The wrapping is freed
+  // if this fails.
+  static napi_status Attach(napi_env env,
+                            napi_value js_rcv,
+                            Wrapping<T>* wrapping);
+  // Frees the wrapping and the native instance, even if deleting the
+  // references fails, in which case the first failure is returned.
+  static napi_status Free(napi_env env, Wrapping<T>* wrapping);
   static napi_status Retrieve(napi_env env,
                               napi_value js_rcv,
                               T** cc_rcv,
                               int ref_idx = -1,
                               napi_value* ref = nullptr,
                               Wrapping<T>** wrapping = nullptr);
-  napi_status SetRef(napi_env env, int idx, napi_value same_obj);
+  // Like `Retrieve()`, for the receiver of a method or an accessor of the
+  // class. Node.js has already checked the receiver of a method against the
+  // class's signature, and that of an accessor is checked against the wrapping
+  // it holds, so the type tag of the receiver is not checked.
+  static napi_status RetrieveReceiver(napi_env env,
+                                      napi_value js_rcv,
+                                      T** cc_rcv,
+                                      int ref_idx = -1,
+                                      napi_value* ref = nullptr,
+                                      Wrapping<T>** wrapping = nullptr);
+  T* Get() const;
  private:
+  Wrapping(T* native, size_t ref_count, BlockPool* pool);
+  static size_t NativeOffset(size_t same_obj_count);
   static void Destroy(napi_env env, void* data, void* hint);
-  T* native = nullptr;
-  std::vector<napi_ref> refs;
+};
+
+// How the elements of the container backing an `iterable`, `maplike`, or
+// `setlike` declaration map to keys and values.
+enum class IterableType {
+  // `iterable<V>`, whose keys are the indices of its values.
+  kIndexed,
+  // `setlike<V>`, whose keys are its values.
+  kSet,
+  // `iterable<K, V>` and `maplike<K, V>`, whose elements hold a key in `first`
+  // and a value in `second`, like those of a `std::map`.
+  kPairs
+};
+
+namespace details {
+
+// Whether `T` is an associative container, whose items `find()` looks up by
+// their `key_type`, such as a `std::map` or a `std::set`.
+template <typename T, typename = void>
+struct AssociativeKey : public std::false_type {
+  struct key_type {};
+};
+
+template <typename T>
+struct AssociativeKey<T, decltype(void(std::declval<const T&>().find(
+    std::declval<const typename T::key_type&>())))>
+    : public std::true_type {
+  typedef typename T::key_type key_type;
+};
+
+}  // end of namespace details
+
+// The bindings of the `iterable`, `maplike`, or `setlike` declaration of the
+// interface `T`, whose native instances are themselves the containers, with
+// `begin()` and `end()`, and with `size()` and `find()` for the `maplike` and
+// `setlike` declarations, such as a class deriving from `std::map`. The
+// iterators step through the native container as JS requests results, and
+// hold a reference to the JS object, so that the container outlives them.
+// Besides `next()`, they have a method `nextBatch(n)`, which returns an array
+// of up to `n` results in one call, and an empty array at the end. Each batch,
+// and each call made by `forEach()`, looks up the next item anew in the live
+// container, by its index, or by its key if the container is associative, so
+// that the container may be modified while JS iterates over it.
+template <typename T, IterableType type>
+class Iterable {
+ public:
+  static napi_value Entries(napi_env env, napi_callback_info info);
+  static napi_value Keys(napi_env env, napi_callback_info info);
+  static napi_value Values(napi_env env, napi_callback_info info);
+  static napi_value ForEach(napi_env env, napi_callback_info info);
+  // The getter of the `size` attribute, and the operations looking up keys,
+  // which only `maplike` and `setlike` declarations have.
+  static napi_value Size(napi_env env, napi_callback_info info);
+  static napi_value Has(napi_env env, napi_callback_info info);
+  static napi_value Get(napi_env env, napi_callback_info info);
+ private:
+  enum Kind {
+    kKeys, kValues, kEntries
+  };
+  typedef decltype(std::declval<const T&>().begin()) iterator;
+  typedef std::integral_constant<IterableType, type> Type;
+  typedef std::integral_constant<IterableType, IterableType::kIndexed> Indexed;
+  typedef std::integral_constant<IterableType, IterableType::kSet> Set;
+  typedef std::integral_constant<IterableType, IterableType::kPairs> Pairs;
+  class Iterator;
+  static napi_value CreateIterator(napi_env env,
+                                   napi_callback_info info,
+                                   Kind kind);
+  static napi_status Retrieve(napi_env env,
+                              napi_callback_info info,
+                              size_t* argc,
+                              napi_value* argv,
+                              napi_value* js_rcv,
+                              const T** cc_rcv);
+  static napi_status ItemToJS(napi_env env,
+                              iterator it,
+                              size_t index,
+                              Kind kind,
+                              napi_value* result);
+  static napi_status
+  KeyToJS(napi_env env, iterator it, size_t index, Indexed, napi_value* result);
+  static napi_status
+  KeyToJS(napi_env env, iterator it, size_t index, Set, napi_value* result);
+  static napi_status
+  KeyToJS(napi_env env, iterator it, size_t index, Pairs, napi_value* result);
+  template <typename Tag>
+  static napi_status ValueToJS(napi_env env,
+                               iterator it,
+                               Tag,
+                               napi_value* result);
+  static napi_status ValueToJS(napi_env env,
+                               iterator it,
+                               Pairs,
+                               napi_value* result);
+  static const size_t slot;
 };
 
 }  // end of namespace WebIdlNapi
 
+using ByteString = WebIdlNapi::ByteString;
+using BufferSource = WebIdlNapi::BufferSource;
+using ArrayBuffer = WebIdlNapi::ArrayBuffer;
+using ArrayBufferView = WebIdlNapi::ArrayBufferView;
+using Int8Array = WebIdlNapi::Int8Array;
+using Uint8Array = WebIdlNapi::Uint8Array;
+using Uint8ClampedArray = WebIdlNapi::Uint8ClampedArray;
+using Int16Array = WebIdlNapi::Int16Array;
+using Uint16Array = WebIdlNapi::Uint16Array;
+using Int32Array = WebIdlNapi::Int32Array;
+using Uint32Array = WebIdlNapi::Uint32Array;
+using Float32Array = WebIdlNapi::Float32Array;
+using Float64Array = WebIdlNapi::Float64Array;
+using BigInt64Array = WebIdlNapi::BigInt64Array;
+using BigUint64Array = WebIdlNapi::BigUint64Array;
+
 #include "webidl-napi-inl.h"
 
 #endif  // WEBIDL_NAPI_H